@@ -30,6 +30,9 @@ using std::exit;
 #include <iostream>
 #include <iterator>
 #include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
 #include <boost/filesystem/operations.hpp>
 
 struct commandline_options {
@@ -38,19 +41,26 @@ struct commandline_options {
     std::string language;
     std::string algorithm;
     bool        debug_parser;
+    std::string batch;      // manifest file, "-" = read jobs from stdin
+    int         jobs;       // worker threads for batch mode, 0 = auto
 };
 
-void get_commandline_options(
-    commandline_options&    cmdopt,
-    int                     argc,
-    const char**            argv) {
+const char* usage =
+    "caper: usage: caper [-c++ | -js | -cs | -cs6 | -d | -java | -boo | -ruby | -php | -haxe] input_filename output_filename\n"
+    "       caper [--jobs N] --batch manifest_filename | -";
+
+bool get_job_options(
+    commandline_options&                cmdopt,
+    const std::vector<std::string>&     args,
+    std::string&                        error) {
     cmdopt.language = "C++";
     cmdopt.algorithm = "lalr1";
     cmdopt.debug_parser = false;
+    cmdopt.jobs = 0;
 
     int state = 0;
-    for (int index = 1 ; index < argc ; index++) {
-        std::string arg = argv[index];
+    for (size_t index = 0 ; index < args.size() ; index++) {
+        const std::string& arg = args[index];
 
         if (arg[0] == '-') {
             if (arg == "-java" || arg == "-Java") {
@@ -110,7 +120,15 @@ void get_commandline_options(
                 cmdopt.debug_parser = true;
                 continue;
             }
-            
+            if (arg == "--batch" && index + 1 < args.size()) {
+                cmdopt.batch = args[++index];
+                continue;
+            }
+            if (arg == "--jobs" && index + 1 < args.size()) {
+                cmdopt.jobs = std::atoi(args[++index].c_str());
+                continue;
+            }
+
 /*
             if (arg == "-lr1") == 0) {
                 cmdopt.algorithm = "lr1";
@@ -118,74 +136,144 @@ void get_commandline_options(
             }
 */
 
-            std::cerr << "caper: unknown option: " << argv[index] << std::endl;
-            exit(1);
+            error = "unknown option: " + arg;
+            return false;
         }
 
         switch (state) {
             case 0: cmdopt.infile = arg; state++; break;
             case 1: cmdopt.outfile = arg; state++; break;
             default:
-                std::cerr << "caper: too many arguments" << std::endl;
-                exit(1);
+                error = "too many arguments";
+                return false;
         }
     }
 
-    if (state < 2) {
-        std::cerr << "caper: usage: caper [-c++ | -js | -cs | -cs6 | -d | -java | -boo | -ruby | -php | -haxe] input_filename output_filename" << std::endl;
+    if (state < 2 && cmdopt.batch.empty()) {
+        error = usage;
+        return false;
+    }
+    return true;
+}
+
+void get_commandline_options(
+    commandline_options&    cmdopt,
+    int                     argc,
+    const char**            argv) {
+    std::vector<std::string> args(argv + 1, argv + argc);
+
+    std::string error;
+    if (!get_job_options(cmdopt, args, error)) {
+        if (error != usage) {
+            std::cerr << "caper: ";
+        }
+        std::cerr << error << std::endl;
         exit(1);
     }
+}
+
+////////////////////////////////////////////////////////////////
+// generators
+typedef void(*generator_type)(
+    const std::string&,
+    std::ostream&,
+    const GenerateOptions&,
+    const std::map<std::string, Type>&,
+    const std::map<std::string, Type>&,
+    const std::vector<std::string>&,
+    const action_map_type&,
+    const tgt::parsing_table&);
 
+generator_type find_generator(const std::string& language) {
+    static const std::unordered_map<std::string, generator_type> generators {
+        { "C++",        generate_cpp },
+        { "JavaScript", generate_javascript },
+        { "C#",         generate_csharp },
+        { "C#8",        generate_csharp9 },
+        { "D",          generate_d },
+        { "Java",       generate_java },
+        { "Boo",        generate_boo },
+        { "Ruby",       generate_ruby },
+        { "PHP",        generate_php },
+        { "Haxe",       generate_haxe },
+    };
+    return generators.at(language);
 }
 
-int main(int argc, const char** argv) {
-    commandline_options cmdopt;
-    get_commandline_options(cmdopt, argc, argv);
+////////////////////////////////////////////////////////////////
+// output_cache
+//   the last generated source of each output file, with everything that
+//   affected it, so that a long-lived batch process does not rebuild
+//   tables for unchanged grammars. An edited grammar replaces the entry of
+//   its output file, so the cache does not grow with resubmissions
+class output_cache {
+public:
+    static std::string make_key(
+        const commandline_options& cmdopt, const std::string& source) {
+        return
+            cmdopt.language + '\0' +
+            (cmdopt.debug_parser ? "1" : "0") + '\0' +
+            source;
+    }
+
+    bool find(
+        const std::string& outfile, const std::string& key,
+        std::string& output) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto i = outputs_.find(outfile);
+        if (i == outputs_.end() || (*i).second.first != key) { return false; }
+        output = (*i).second.second;
+        return true;
+    }
+
+    void insert(
+        const std::string& outfile, const std::string& key,
+        const std::string& output) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        outputs_[outfile] = std::make_pair(key, output);
+    }
 
-    typedef void(*generator_type)(
-        const std::string&,
-        std::ostream&,
-        const GenerateOptions&,
-        const std::map<std::string, Type>&,
-        const std::map<std::string, Type>&,
-        const std::vector<std::string>&,
-        const action_map_type&,
-        const tgt::parsing_table&);
-
-    std::unordered_map<std::string, generator_type> generators;
-    generators["C++"]           = generate_cpp;
-    generators["JavaScript"]    = generate_javascript;
-    generators["C#"]            = generate_csharp;
-    generators["C#8"]           = generate_csharp9;
-    generators["D"]             = generate_d;
-    generators["Java"]          = generate_java;
-    generators["Boo"]           = generate_boo;
-    generators["Ruby"]          = generate_ruby;
-    generators["PHP"]           = generate_php;
-    generators["Haxe"]          = generate_haxe;
-
-    std::ifstream ifs(cmdopt.infile.c_str());
+private:
+    typedef std::pair<std::string, std::string> entry_type; // key, output
+
+    std::mutex                                      mutex_;
+    std::unordered_map<std::string, entry_type>     outputs_;
+
+};
+
+////////////////////////////////////////////////////////////////
+// compile_grammar
+bool compile_grammar(
+    const commandline_options&  cmdopt,
+    const cpg::parser&          prototype,
+    output_cache*               cache,
+    std::string&                output,
+    std::ostream&               log) {
+
+    std::ifstream ifs(cmdopt.infile.c_str(), std::ios::binary);
     if (!ifs) {
-        std::cerr << "caper: can't open input file '" << cmdopt.infile << "'" << std::endl;
-        exit(1);
+        log << "caper: can't open input file '" << cmdopt.infile << "'" << std::endl;
+        return false;
     }
+    std::string source(
+        (std::istreambuf_iterator<char>(ifs)),
+        std::istreambuf_iterator<char>());
 
-    std::ofstream ofs(cmdopt.outfile.c_str());
-    if (!ofs) {
-        std::cerr << "caper: can't open output file '" << cmdopt.outfile << "'" << std::endl;
-        exit(1);
+    std::string key;
+    if (cache) {
+        key = output_cache::make_key(cmdopt, source);
+        if (cache->find(cmdopt.outfile, key, output)) {
+            return true;
+        }
     }
 
     // cpgXLi
-    typedef std::istreambuf_iterator<char> is_iterator;
-    is_iterator b(ifs);
-    is_iterator e;
-    scanner<is_iterator> s(b, e);
+    typedef std::string::const_iterator is_iterator;
+    scanner<is_iterator> s(source.begin(), source.end());
 
     try {
         // cpgp[T
-        cpg::parser p;
-        make_cpg_parser(p);
+        cpg::parser p(prototype);
 
         // cpgp[X
         Token token = token_empty;
@@ -230,7 +318,8 @@ int main(int argc, const char** argv) {
         for (const auto& x: token_id_map) {
             tokens[x.second] = x.first;
         }
-        generators[cmdopt.language](
+        std::ostringstream ofs;
+        find_generator(cmdopt.language)(
             cmdopt.outfile,
             ofs,
             options,
@@ -239,26 +328,253 @@ int main(int argc, const char** argv) {
             tokens,
             actions,
             table);
-
+        output = ofs.str();
     }
     catch(caper_error& e) {
         if (e.addr <0) {
-            std::cerr << "caper: " << e.what() << std::endl;
+            log << "caper: " << e.what() << std::endl;
         } else {
-            std::cerr << "caper: " 
-                      << e.what()
-                      << ", line: " << s.lineno(e.addr)
-                      << ", column: " << s.column(e.addr)
-                      << std::endl;
+            log << "caper: "
+                << e.what()
+                << ", line: " << s.lineno(e.addr)
+                << ", column: " << s.column(e.addr)
+                << std::endl;
         }
 
-        ofs.close();
         boost::filesystem::remove(cmdopt.outfile);
 
-        return 1;
+        return false;
     }
     catch(std::exception& e) {
-        std::cerr << e.what() << std::endl;
+        log << e.what() << std::endl;
+        return false;
+    }
+
+    if (cache) {
+        cache->insert(cmdopt.outfile, key, output);
+    }
+    return true;
+}
+
+////////////////////////////////////////////////////////////////
+// write_output
+bool write_output(
+    const std::string&  filename,
+    const std::string&  output,
+    bool                only_if_changed,
+    bool&               written,
+    std::ostream&       log) {
+    written = false;
+    if (only_if_changed) {
+        // leave the file (and its timestamp) alone if nothing changed
+        std::ifstream ifs(filename.c_str(), std::ios::binary);
+        if (ifs) {
+            std::string current(
+                (std::istreambuf_iterator<char>(ifs)),
+                std::istreambuf_iterator<char>());
+            if (current == output) {
+                return true;
+            }
+        }
+    }
+
+    std::ofstream ofs(filename.c_str());
+    if (!ofs) {
+        log << "caper: can't open output file '" << filename << "'" << std::endl;
+        return false;
+    }
+    ofs << output;
+    ofs.close();
+    if (!ofs) {
+        log << "caper: can't write output file '" << filename << "'" << std::endl;
+        return false;
+    }
+    written = true;
+    return true;
+}
+
+////////////////////////////////////////////////////////////////
+// batch mode
+struct batch_job {
+    commandline_options cmdopt;
+    std::string         error;      // manifest error
+    bool                succeeded   = false;
+    bool                written     = false;
+    std::string         log;
+};
+
+std::vector<std::string> split_manifest_line(const std::string& line) {
+    // whitespace separated, "..." for names containing spaces
+    std::vector<std::string> args;
+    size_t i = 0;
+    while (i < line.size()) {
+        while (i < line.size() && isspace((unsigned char)line[i])) { i++; }
+        if (i == line.size() || line[i] == '#') { break; }
+
+        std::string arg;
+        if (line[i] == '"') {
+            size_t j = line.find('"', i + 1);
+            if (j == std::string::npos) { j = line.size(); }
+            arg = line.substr(i + 1, j - i - 1);
+            i = j + 1;
+        } else {
+            while (i < line.size() && !isspace((unsigned char)line[i])) {
+                arg += line[i++];
+            }
+        }
+        args.push_back(arg);
+    }
+    return args;
+}
+
+bool add_batch_job(std::vector<batch_job>& jobs, const std::string& line) {
+    std::vector<std::string> args = split_manifest_line(line);
+    if (args.empty()) {
+        return false;
+    }
+
+    batch_job job;
+    if (get_job_options(job.cmdopt, args, job.error) &&
+        !job.cmdopt.batch.empty()) {
+        job.error = "nested --batch in manifest";
+    }
+    if (job.error == usage) {
+        job.error = "manifest line needs input_filename and output_filename: " + line;
+    }
+    jobs.push_back(job);
+    return true;
+}
+
+std::string name_input(const std::string& infile, const std::string& log) {
+    // jobs log to one stream, so each line says which grammar it is about
+    if (infile.empty()) {
+        return log;
+    }
+    const std::string tag = "caper: ";
+    std::istringstream lines(log);
+    std::ostringstream named;
+    std::string line;
+    while (std::getline(lines, line)) {
+        if (line.compare(0, tag.size(), tag) == 0) {
+            line = line.substr(tag.size());
+        }
+        named << tag << infile << ": " << line << std::endl;
+    }
+    return named.str();
+}
+
+void run_batch_jobs(
+    std::vector<batch_job>& jobs,
+    int                     thread_count,
+    const cpg::parser&      prototype,
+    output_cache&           cache) {
+    if (thread_count <= 0) {
+        thread_count = int(std::thread::hardware_concurrency());
+    }
+    thread_count = (std::max)(1, (std::min)(thread_count, int(jobs.size())));
+
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+        size_t index;
+        while ((index = next++) < jobs.size()) {
+            batch_job& job = jobs[index];
+            std::ostringstream log;
+            if (!job.error.empty()) {
+                log << "caper: " << job.error << std::endl;
+            } else {
+                std::string output;
+                job.succeeded =
+                    compile_grammar(job.cmdopt, prototype, &cache, output, log) &&
+                    write_output(job.cmdopt.outfile, output, true, job.written, log);
+            }
+            job.log = name_input(job.cmdopt.infile, log.str());
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int i = 1 ; i < thread_count ; i++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& t: threads) {
+        t.join();
+    }
+}
+
+int run_batch(const commandline_options& cmdopt, const cpg::parser& prototype) {
+    output_cache cache;
+
+    if (cmdopt.batch == "-") {
+        // long-lived mode for build tools: one job per line, an empty line
+        // (or EOF) runs the pending jobs and reports one status line per job
+        // followed by an empty line
+        std::vector<batch_job> jobs;
+        std::string line;
+        bool more = true;
+        while (more) {
+            more = bool(std::getline(std::cin, line));
+            if (more && add_batch_job(jobs, line)) {
+                continue;
+            }
+            if (jobs.empty()) {
+                continue;
+            }
+
+            run_batch_jobs(jobs, cmdopt.jobs, prototype, cache);
+            for (const auto& job: jobs) {
+                std::cerr << job.log;
+                std::cout
+                    << (!job.succeeded ? "error" :
+                        job.written ? "written" : "unchanged")
+                    << " " << job.cmdopt.outfile << "\n";
+            }
+            std::cout << std::endl;
+            jobs.clear();
+        }
+        return 0;
+    }
+
+    std::ifstream ifs(cmdopt.batch.c_str());
+    if (!ifs) {
+        std::cerr << "caper: can't open manifest file '" << cmdopt.batch << "'" << std::endl;
+        return 1;
+    }
+
+    std::vector<batch_job> jobs;
+    std::string line;
+    while (std::getline(ifs, line)) {
+        add_batch_job(jobs, line);
+    }
+
+    run_batch_jobs(jobs, cmdopt.jobs, prototype, cache);
+
+    int result = 0;
+    for (const auto& job: jobs) {
+        std::cerr << job.log;
+        if (!job.succeeded) { result = 1; }
+    }
+    return result;
+}
+
+int main(int argc, const char** argv) {
+    commandline_options cmdopt;
+    get_commandline_options(cmdopt, argc, argv);
+
+    // cpgp[T(WuԂŋL)
+    cpg::parser prototype;
+    make_cpg_parser(prototype);
+
+    if (!cmdopt.batch.empty()) {
+        return run_batch(cmdopt, prototype);
+    }
+
+    std::string output;
+    if (!compile_grammar(cmdopt, prototype, nullptr, output, std::cerr)) {
+        return 1;
+    }
+
+    bool written;
+    if (!write_output(cmdopt.outfile, output, false, written, std::cerr)) {
         return 1;
     }
 
@@ -84,6 +84,15 @@ struct TypeTag {
     TypeTag(const std::string& as) : s(as) {}
 };
 
+////////////////////////////////////////////////////////////////
+// Literal
+struct Literal {
+    std::string s;
+
+    Literal() {}
+    Literal(const std::string& as) : s(as) {}
+};
+
 ////////////////////////////////////////////////////////////////
 // Integer
 struct Integer {
@@ -108,7 +117,7 @@ typedef std::shared_ptr<Node> node_ptr;
 ////////////////////////////////////////////////////////////////
 // value_type
 struct Value {
-    typedef boost::variant<Nil, Operator, Identifier, Directive, TypeTag, Integer, node_ptr> data_type;
+    typedef boost::variant<Nil, Operator, Identifier, Directive, TypeTag, Literal, Integer, node_ptr> data_type;
 
     Range       range;
     data_type   data;
@@ -261,6 +270,65 @@ struct DontUseSTLDecl : public Declaration {
     DontUseSTLDecl(const Range& r) : Declaration(r) {}
 };
 
+struct TableDrivenDecl : public Declaration {
+    TableDrivenDecl(const Range& r) : Declaration(r) {}
+};
+
+struct ComputedGotoDecl : public Declaration {
+    ComputedGotoDecl(const Range& r) : Declaration(r) {}
+};
+
+struct TypedStackDecl : public Declaration {
+    TypedStackDecl(const Range& r) : Declaration(r) {}
+};
+
+struct StreamingSequenceDecl : public Declaration {
+    StreamingSequenceDecl(const Range& r) : Declaration(r) {}
+};
+
+struct ArenaDecl : public Declaration {
+    ArenaDecl(const Range& r) : Declaration(r) {}
+};
+
+struct ProfileDecl : public Declaration {
+    ProfileDecl(const Range& r) : Declaration(r) {}
+};
+
+struct SplitImplementationDecl : public Declaration {
+    SplitImplementationDecl(const Range& r) : Declaration(r) {}
+};
+
+struct ConstexprDecl : public Declaration {
+    ConstexprDecl(const Range& r) : Declaration(r) {}
+};
+
+struct GlrDecl : public Declaration {
+    GlrDecl(const Range& r) : Declaration(r) {}
+};
+
+struct IncrementalDecl : public Declaration {
+    IncrementalDecl(const Range& r) : Declaration(r) {}
+};
+
+struct LexDecl : public Declaration {
+    std::string     name;
+    std::string     pattern;
+
+    LexDecl(const Range& r, const std::string& an, const std::string& ap)
+        : Declaration(r), name(an), pattern(ap) {}
+};
+
+struct RecoverSyncDecl : public Declaration {
+    RecoverSyncDecl(const Range& r) : Declaration(r) {}
+};
+
+struct ParallelDecl : public Declaration {
+    std::string     name;
+
+    ParallelDecl(const Range& r, const std::string& as)
+        : Declaration(r), name(as) {}
+};
+
 struct ValueTypeDecl : public Declaration {
     std::string     name;
 
@@ -296,6 +364,15 @@ struct TargetTokenTraits {
 typedef zw::gr::package<Token, TokenTraits, Value>    cpg;
 typedef zw::gr::package<int, TargetTokenTraits, int>  tgt;
 
+struct LexRule {
+    int             addr;
+    std::string     token;      // empty for a skipped pattern
+    std::string     pattern;
+
+    LexRule(int a, const std::string& at, const std::string& ap)
+        : addr(a), token(at), pattern(ap) {}
+};
+
 struct GenerateOptions {
     bool            debug_parser         = false;
     std::string     token_prefix         = "token_";
@@ -307,9 +384,23 @@ struct GenerateOptions {
     std::string     value_type           = "";
     std::string     value_type_namespace = "";
     bool            dont_use_stl         = false;
+    bool            table_driven         = false;
+    bool            computed_goto        = false;
+    bool            typed_stack          = false;
+    bool            streaming_sequence   = false;
+    bool            arena                = false;
+    bool            profile              = false;
+    bool            split_implementation = false;
+    bool            constexpr_tables     = false;
+    bool            glr                  = false;
+    bool            incremental          = false;
     bool            recovery             = false;
+    bool            recovery_sync        = false;
     std::string     recovery_token       = "error";
     std::string     smart_pointer_tag    = "";
+    std::vector<LexRule> lex_rules;
+    std::string     parallel_element     = "";
+    int             parallel_addr        = -1;
 };
 
 struct Type {
@@ -153,6 +153,97 @@ void make_cpg_parser(cpg::parser& p) {
             return Value(args[0]);
         },
         "ValueTypeDecl", token_semicolon);
+    make_rule(
+        g, p,
+        "Declaration",
+        [](const arguments_type& args) -> Value {
+            return Value(args[0]);
+        },
+        "TableDrivenDecl", token_semicolon);
+    make_rule(
+        g, p,
+        "Declaration",
+        [](const arguments_type& args) -> Value {
+            return Value(args[0]);
+        },
+        "ComputedGotoDecl", token_semicolon);
+    make_rule(
+        g, p,
+        "Declaration",
+        [](const arguments_type& args) -> Value {
+            return Value(args[0]);
+        },
+        "TypedStackDecl", token_semicolon);
+    make_rule(
+        g, p,
+        "Declaration",
+        [](const arguments_type& args) -> Value {
+            return Value(args[0]);
+        },
+        "StreamingSequenceDecl", token_semicolon);
+    make_rule(
+        g, p,
+        "Declaration",
+        [](const arguments_type& args) -> Value {
+            return Value(args[0]);
+        },
+        "ArenaDecl", token_semicolon);
+    make_rule(
+        g, p,
+        "Declaration",
+        [](const arguments_type& args) -> Value {
+            return Value(args[0]);
+        },
+        "ProfileDecl", token_semicolon);
+    make_rule(
+        g, p,
+        "Declaration",
+        [](const arguments_type& args) -> Value {
+            return Value(args[0]);
+        },
+        "SplitImplementationDecl", token_semicolon);
+    make_rule(
+        g, p,
+        "Declaration",
+        [](const arguments_type& args) -> Value {
+            return Value(args[0]);
+        },
+        "ConstexprDecl", token_semicolon);
+    make_rule(
+        g, p,
+        "Declaration",
+        [](const arguments_type& args) -> Value {
+            return Value(args[0]);
+        },
+        "GlrDecl", token_semicolon);
+    make_rule(
+        g, p,
+        "Declaration",
+        [](const arguments_type& args) -> Value {
+            return Value(args[0]);
+        },
+        "IncrementalDecl", token_semicolon);
+    make_rule(
+        g, p,
+        "Declaration",
+        [](const arguments_type& args) -> Value {
+            return Value(args[0]);
+        },
+        "LexDecl", token_semicolon);
+    make_rule(
+        g, p,
+        "Declaration",
+        [](const arguments_type& args) -> Value {
+            return Value(args[0]);
+        },
+        "ParallelDecl", token_semicolon);
+    make_rule(
+        g, p,
+        "Declaration",
+        [](const arguments_type& args) -> Value {
+            return Value(args[0]);
+        },
+        "RecoverSyncDecl", token_semicolon);
 
     // ..%token錾
     make_rule(
@@ -314,6 +405,149 @@ void make_cpg_parser(cpg::parser& p) {
         },
         token_directive_value_type, token_identifier);
 
+    // ..%table_driven錾
+    make_rule(
+        g, p,
+        "TableDrivenDecl",
+        [](const arguments_type& args) -> Value {
+            auto p = std::make_shared<TableDrivenDecl>(range(args));
+            return Value(p);
+        },
+        token_directive_table_driven);
+
+    // ..%computed_goto錾
+    make_rule(
+        g, p,
+        "ComputedGotoDecl",
+        [](const arguments_type& args) -> Value {
+            auto p = std::make_shared<ComputedGotoDecl>(range(args));
+            return Value(p);
+        },
+        token_directive_computed_goto);
+
+    // ..%typed_stack錾
+    make_rule(
+        g, p,
+        "TypedStackDecl",
+        [](const arguments_type& args) -> Value {
+            auto p = std::make_shared<TypedStackDecl>(range(args));
+            return Value(p);
+        },
+        token_directive_typed_stack);
+
+    // ..%streaming_sequence錾
+    make_rule(
+        g, p,
+        "StreamingSequenceDecl",
+        [](const arguments_type& args) -> Value {
+            auto p = std::make_shared<StreamingSequenceDecl>(range(args));
+            return Value(p);
+        },
+        token_directive_streaming_sequence);
+
+    // ..%arena錾
+    make_rule(
+        g, p,
+        "ArenaDecl",
+        [](const arguments_type& args) -> Value {
+            auto p = std::make_shared<ArenaDecl>(range(args));
+            return Value(p);
+        },
+        token_directive_arena);
+
+    // ..%profile錾
+    make_rule(
+        g, p,
+        "ProfileDecl",
+        [](const arguments_type& args) -> Value {
+            auto p = std::make_shared<ProfileDecl>(range(args));
+            return Value(p);
+        },
+        token_directive_profile);
+
+    // ..%split_implementation錾
+    make_rule(
+        g, p,
+        "SplitImplementationDecl",
+        [](const arguments_type& args) -> Value {
+            auto p = std::make_shared<SplitImplementationDecl>(range(args));
+            return Value(p);
+        },
+        token_directive_split_implementation);
+
+    // ..%constexpr錾
+    make_rule(
+        g, p,
+        "ConstexprDecl",
+        [](const arguments_type& args) -> Value {
+            auto p = std::make_shared<ConstexprDecl>(range(args));
+            return Value(p);
+        },
+        token_directive_constexpr);
+
+    // ..%glr錾
+    make_rule(
+        g, p,
+        "GlrDecl",
+        [](const arguments_type& args) -> Value {
+            auto p = std::make_shared<GlrDecl>(range(args));
+            return Value(p);
+        },
+        token_directive_glr);
+
+    // ..%incremental錾
+    make_rule(
+        g, p,
+        "IncrementalDecl",
+        [](const arguments_type& args) -> Value {
+            auto p = std::make_shared<IncrementalDecl>(range(args));
+            return Value(p);
+        },
+        token_directive_incremental);
+
+    // ..%lex錾
+    make_rule(
+        g, p,
+        "LexDecl",
+        [](const arguments_type& args) -> Value {
+            auto p = std::make_shared<LexDecl>(
+                range(args),
+                get_symbol<Identifier>(args[1]),
+                get_symbol<Literal>(args[2]));
+            return Value(p);
+        },
+        token_directive_lex, token_identifier, token_string);
+    make_rule(
+        g, p,
+        "LexDecl",
+        [](const arguments_type& args) -> Value {
+            auto p = std::make_shared<LexDecl>(
+                range(args), "", get_symbol<Literal>(args[1]));
+            return Value(p);
+        },
+        token_directive_lex, token_string);
+
+    // ..%parallel錾
+    make_rule(
+        g, p,
+        "ParallelDecl",
+        [](const arguments_type& args) -> Value {
+            auto p = std::make_shared<ParallelDecl>(
+                range(args), get_symbol<Identifier>(args[1]));
+            return Value(p);
+        },
+        token_directive_parallel, token_identifier);
+
+    // ..%recover_sync錾
+    make_rule(
+        g, p,
+        "RecoverSyncDecl",
+        [](const arguments_type& args) -> Value {
+            auto p = std::make_shared<RecoverSyncDecl>(range(args));
+            return Value(p);
+        },
+        token_directive_recover_sync);
+
     // .@ZNV
     make_rule(
         g, p,
@@ -110,6 +110,22 @@ public:
         : caper_error(a, "EBNF is not allowed, use %allow_ebnf"){
     }
 };
+class bad_regex : public caper_error {
+public:
+    bad_regex(int a, const std::string& p, const std::string& m)
+        : caper_error(a, fmt("bad regular expression \"%s\": %s", p, m)){
+    }
+};
+class unparallelizable_sequence : public caper_error {
+public:
+    unparallelizable_sequence(int a, const std::string& m)
+        : caper_error(
+            a,
+            fmt("no sequence of '%s' to parse in parallel: it must occur "
+                "once, in a rule of the start symbol, which no rule uses",
+                m)){
+    }
+};
 
 class unsupported_feature : public caper_error {
 public:
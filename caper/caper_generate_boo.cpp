@@ -32,6 +32,9 @@ void generate_boo(
     if (options.allow_ebnf) {
         throw unsupported_feature("Boo", "EBNF");
     }
+    if (!options.lex_rules.empty()) {
+        throw unsupported_feature("Boo", "%lex");
+    }
 
     // notice / URL
     stencil(
@@ -4,11 +4,19 @@
 // $Id$
 
 #include "caper_ast.hpp"
+#include "caper_error.hpp"
 #include "caper_generate_cpp.hpp"
 #include "caper_format.hpp"
 #include "caper_stencil.hpp"
 #include "caper_finder.hpp"
+#include "caper_lex.hpp"
 #include <algorithm>
+#include <cstring>
+#include <exception>
+#include <set>
+#include <sstream>
+#include <thread>
+#include <vector>
 #include <boost/tuple/tuple.hpp>
 #include <boost/tuple/tuple_comparison.hpp>
 
@@ -48,7 +56,7 @@ std::string make_arg_decl(const Type& x, size_t l, const std::string& smart_poin
         case Extension::Question:
         case Extension::Slash:
             return
-                y + "(sa_, stack_, seq_get_range(base, arg_index" + sl + "))";
+                y + "(*sa_, stack_, seq_get_range(base, arg_index" + sl + "))";
         default:
             assert(0);
             return "";
@@ -75,27 +83,3057 @@ void make_signature(
     }
 }
 
+// name of the member function called for a special action; under
+// %streaming_sequence the sequence helpers take the element type
+std::string make_special_call_name(
+    const std::map<std::string, Type>&      terminal_types,
+    const std::map<std::string, Type>&      nonterminal_types,
+    const tgt::parsing_table::rule_type&    rule,
+    const SemanticAction&                   sa,
+    const GenerateOptions&                  options) {
+    if (!options.streaming_sequence || sa.name.compare(0, 4, "seq_") != 0) {
+        return sa.name;
+    }
+
+    // EBNF nonterminals are typed with the name of their element symbol
+    const std::string& element =
+        (*finder(nonterminal_types, rule.left().name())).name;
+    auto k = finder(terminal_types, element);
+    const Type& type = k ? *k : *finder(nonterminal_types, element);
+    return sa.name + "_stream<" +
+        make_type_name(Type(type.name, Extension::None),
+                       options.smart_pointer_tag) + " >";
+}
+
 std::string normalize_internal_sa_name(const std::string& s) {
     std::string r;
     for(auto c: s) {
         if (c == '<' || c == '>') {
             r += "__";
         } else {
-            r += c;
+            r += c;
+        }
+    }
+    return r;
+}
+
+std::string normalize_sa_call(const std::string& s) {
+    std::string prefix;
+    for(auto c: s) {
+        if (c == '<' || c == '>') {
+            prefix = "template ";
+            break;
+        }
+    }
+    return prefix + s;
+}
+
+template <class F>
+void emit_states(std::ostream& os, const tgt::parsing_table& table, F emit) {
+    const auto& states = table.states();
+    size_t n = states.size();
+
+    // small tables are not worth the threads
+    const size_t min_chunk = 64;
+    size_t thread_count = std::min<size_t>(
+        std::thread::hardware_concurrency(), n / min_chunk);
+    if (thread_count < 2) {
+        for (const auto& state: states) {
+            emit(os, state);
+        }
+        return;
+    }
+
+    std::vector<std::ostringstream> chunks(thread_count);
+    std::vector<std::exception_ptr> errors(thread_count);
+    std::vector<std::thread> threads;
+    for (size_t i = 0 ; i < thread_count ; i++) {
+        threads.emplace_back([&, i]() {
+                try {
+                    size_t beg = n * i / thread_count;
+                    size_t end = n * (i + 1) / thread_count;
+                    for (size_t j = beg ; j < end ; j++) {
+                        emit(chunks[i], states[j]);
+                    }
+                } catch (...) {
+                    errors[i] = std::current_exception();
+                }
+            });
+    }
+    for (auto& t: threads) {
+        t.join();
+    }
+
+    for (size_t i = 0 ; i < thread_count ; i++) {
+        if (errors[i]) {
+            std::rethrow_exception(errors[i]);
+        }
+        const std::string& s = chunks[i].str();
+        os.write(s.data(), s.size());
+    }
+}
+
+// %split_implementation: the bulky members are only declared in the class
+// and are defined after it, in a section that a single translation unit
+// compiles; the grammar tables become namespace scope data shared by all
+// instantiations (so do they with %constexpr, in the header)
+struct out_of_line {
+    bool                enabled = false;
+    std::string         table_specifier; // "extern const" / "constexpr"
+    std::string         template_head;  // template <...>
+    std::string         class_name;     // Parser<...>
+    std::ostringstream  members;        // member definitions
+};
+
+// first line of a member function definition
+std::string member_head(
+    const out_of_line&  ool,
+    const std::string&  type,
+    const std::string&  declarator) {
+    if (!ool.enabled) {
+        return "    " + type + " " + declarator + " {\n";
+    }
+    return "    " + ool.template_head + "\n    " + type + " " +
+        ool.class_name + "::" + declarator + " {\n";
+}
+
+// member function declaration in the class, when defined out of line
+void emit_member_declaration(
+    std::ostream&       os,
+    const out_of_line&  ool,
+    const std::string&  type,
+    const std::string&  declarator) {
+    if (ool.enabled) {
+        os << "    " << type << " " << declarator << ";\n";
+    }
+}
+
+// the error path of the state code; with %parallel, a parser speculating on
+// a chunk leaves reporting to the parse that posts the chunk again
+std::string report_syntax_error(const GenerateOptions& options) {
+    return options.parallel_element.empty() ?
+        "sa_->syntax_error();" :
+        "if (!speculating_) { sa_->syntax_error(); }";
+}
+
+// smallest unsigned type for table elements in [0, max_value]
+const char* table_element_type(int max_value) {
+    if (max_value < 0x100) { return "unsigned char"; }
+    if (max_value < 0x10000) { return "unsigned short"; }
+    return "unsigned int";
+}
+
+void emit_table_elements(
+    std::ostream&                   os,
+    const char*                     indent,
+    const std::vector<std::string>& elements) {
+    const size_t per_line = 16;
+    for (size_t i = 0 ; i < elements.size() ; i++) {
+        os << (i % per_line == 0 ? indent : " ") << elements[i] << ",";
+        if (i % per_line == per_line - 1 || i == elements.size() - 1) {
+            os << "\n";
+        }
+    }
+}
+
+std::vector<std::string> table_elements(const std::vector<int>& values) {
+    std::vector<std::string> elements;
+    for (int x: values) {
+        elements.push_back(std::to_string(x));
+    }
+    return elements;
+}
+
+const char* table_element_type(const std::vector<int>& values) {
+    int max_value = 0;
+    for (int x: values) {
+        max_value = (std::max)(max_value, x);
+    }
+    return table_element_type(max_value);
+}
+
+// a table read by one member function: its local static, or a pointer to
+// the namespace scope table
+void emit_table(
+    std::ostream&                   os,
+    const out_of_line&              ool,
+    const std::string&              type,
+    const std::string&              name,
+    const std::vector<std::string>& elements) {
+    if (!ool.table_specifier.empty()) {
+        stencil(
+            os, R"(
+        const ${type}* const ${name} = parser_tables::${name};
+)",
+            {"type", type},
+            {"name", name}
+            );
+        return;
+    }
+    stencil(
+        os, R"(
+        static const ${type} ${name}[] = {
+$${elements}
+        };
+)",
+        {"type", type},
+        {"name", name},
+        {"elements", [&](std::ostream& os) {
+                emit_table_elements(os, "            ", elements);
+            }}
+        );
+}
+
+void emit_table(
+    std::ostream&           os,
+    const out_of_line&      ool,
+    const std::string&      name,
+    const std::vector<int>& values) {
+    emit_table(
+        os, ool, table_element_type(values), name, table_elements(values));
+}
+
+// namespace scope table
+void emit_table_definition(
+    std::ostream&                   os,
+    const std::string&              specifier,
+    const std::string&              type,
+    const std::string&              name,
+    const std::vector<std::string>& elements) {
+    stencil(
+        os, R"(
+${specifier} ${type} ${name}[] = {
+$${elements}
+};
+
+)",
+        {"specifier", specifier},
+        {"type", type},
+        {"name", name},
+        {"elements", [&](std::ostream& os) {
+                emit_table_elements(os, "    ", elements);
+            }}
+        );
+}
+
+void emit_table_definition(
+    std::ostream&           os,
+    const std::string&      specifier,
+    const std::string&      name,
+    const std::vector<int>& values) {
+    emit_table_definition(
+        os, specifier, table_element_type(values), name,
+        table_elements(values));
+}
+
+// row displacement packing: the entries (column, value) of row r are
+// stored at base[r] + column, and check[] names the row owning a slot.
+// every row is given room for all columns, so lookups need no bounds
+// check
+struct packed_rows {
+    std::vector<int> base;
+    std::vector<int> check;
+    std::vector<int> value;
+};
+
+void pack_rows(
+    const std::vector<std::vector<std::pair<int, int>>>&    rows,
+    int                                                     columns,
+    packed_rows&                                            t) {
+    const int nobody = int(rows.size());
+
+    // long rows first, they are the hardest to fit
+    std::vector<size_t> order;
+    for (size_t r = 0 ; r < rows.size() ; r++) {
+        order.push_back(r);
+    }
+    std::stable_sort(
+        order.begin(), order.end(),
+        [&](size_t x, size_t y) { return rows[y].size() < rows[x].size(); });
+
+    t.base.assign(rows.size(), 0);
+    for (size_t r: order) {
+        int b = 0;
+        for (;; b++) {
+            bool fit = true;
+            for (const auto& e: rows[r]) {
+                size_t k = b + e.first;
+                if (k < t.check.size() && t.check[k] != nobody) {
+                    fit = false;
+                    break;
+                }
+            }
+            if (fit) { break; }
+        }
+
+        t.base[r] = b;
+        if (t.check.size() < size_t(b + columns)) {
+            t.check.resize(b + columns, nobody);
+            t.value.resize(b + columns, 0);
+        }
+        for (const auto& e: rows[r]) {
+            t.check[b + e.first] = int(r);
+            t.value[b + e.first] = e.second;
+        }
+    }
+}
+
+// %table_driven / %constexpr: the parsing tables
+//   actions: (arg << 2) | kind
+//     kind 1: shift, arg = state / 2: reduce, arg = rule / 3: accept
+//   error actions are left out (same as no entry)
+struct driver_tables {
+    // action rows packed by token, or, with %external_token, the
+    // (token, action) pairs of state s in [action_base[s],
+    // action_base[s + 1])
+    std::vector<int>            action_base;
+    std::vector<int>            action_check;
+    std::vector<std::string>    action_token;
+    std::vector<int>            action_value;
+
+    // goto rows packed by nonterminal index
+    packed_rows                 goto_rows;
+
+    std::vector<int>            rule_length;
+    std::vector<int>            rule_lhs;
+    std::set<size_t>            reduced_rules;
+
+    // %glr: the actions conflicts left out, (token, action) pairs of state
+    // s in [alternative_base[s], alternative_base[s + 1])
+    std::vector<int>            alternative_base;
+    std::vector<std::string>    alternative_token;
+    std::vector<int>            alternative_value;
+};
+
+void make_driver_tables(
+    const GenerateOptions&                      options,
+    const std::map<std::string, Type>&          nonterminal_types,
+    const std::vector<std::string>&             tokens,
+    const tgt::parsing_table&                   table,
+    driver_tables&                              t) {
+    const auto& grammar = table.get_grammar();
+    typedef std::vector<std::vector<std::pair<int, int>>> rows_type;
+
+    // Nonterminal enumerators are emitted in nonterminal_types order
+    std::map<std::string, int> nonterminal_indices;
+    for (const auto& pair: nonterminal_types) {
+        int n = int(nonterminal_indices.size());
+        nonterminal_indices[pair.first] = n;
+    }
+
+    auto encode = [&](const tgt::parsing_table::action& action) -> int {
+        switch (action.type) {
+            case zw::gr::action_shift:
+                return (action.dest_index << 2) | 1;
+            case zw::gr::action_reduce:
+                t.reduced_rules.insert(action.rule.id());
+                return (int(action.rule.id()) << 2) | 2;
+            case zw::gr::action_accept:
+                return 3;
+            default:
+                return 0;
+        }
+    };
+
+    rows_type action_rows;
+    for (const auto& state: table.states()) {
+        action_rows.push_back(rows_type::value_type());
+        for (const auto& pair: state.action_table) {
+            int value = encode(pair.second);
+            if (value == 0) {
+                continue;
+            }
+            action_rows.back().push_back(std::make_pair(pair.first, value));
+        }
+    }
+
+    if (options.glr) {
+        for (const auto& state: table.states()) {
+            t.alternative_base.push_back(int(t.alternative_value.size()));
+            for (const auto& pair: state.alternatives) {
+                t.alternative_token.push_back(
+                    options.token_prefix + tokens[pair.first]);
+                t.alternative_value.push_back(encode(pair.second));
+            }
+        }
+        t.alternative_base.push_back(int(t.alternative_value.size()));
+        if (t.alternative_value.empty()) {
+            // never read; arrays can't be empty
+            t.alternative_token.push_back("0");
+            t.alternative_value.push_back(0);
+        }
+    }
+
+    if (options.external_token) {
+        // token values are not known here, so rows can't be packed by
+        // token; scan the (token, action) pairs of the state instead
+        for (const auto& row: action_rows) {
+            t.action_base.push_back(int(t.action_value.size()));
+            for (const auto& e: row) {
+                t.action_token.push_back(
+                    options.token_prefix + tokens[e.first]);
+                t.action_value.push_back(e.second);
+            }
+        }
+        t.action_base.push_back(int(t.action_value.size()));
+    } else {
+        packed_rows packed;
+        pack_rows(action_rows, int(tokens.size()), packed);
+        t.action_base = packed.base;
+        t.action_check = packed.check;
+        t.action_value = packed.value;
+    }
+
+    rows_type goto_rows;
+    for (const auto& state: table.states()) {
+        goto_rows.push_back(rows_type::value_type());
+        for (const auto& pair: state.goto_table) {
+            goto_rows.back().push_back(
+                std::make_pair(
+                    *finder(nonterminal_indices, pair.first.name()),
+                    pair.second));
+        }
+    }
+    pack_rows(goto_rows, int(nonterminal_types.size()), t.goto_rows);
+
+    for (const auto& rule: grammar) {
+        t.rule_length.push_back(int(rule.right().size()));
+        auto k = finder(nonterminal_indices, rule.left().name());
+        t.rule_lhs.push_back(k ? *k : 0); // root rule is never reduced
+    }
+}
+
+void emit_driver_table_definitions(
+    std::ostream&                               os,
+    const std::string&                          specifier,
+    const driver_tables&                        t) {
+    os << "namespace parser_tables {\n\n";
+    emit_table_definition(os, specifier, "action_base", t.action_base);
+    if (t.action_check.empty()) {
+        emit_table_definition(
+            os, specifier, "int", "action_token", t.action_token);
+    } else {
+        emit_table_definition(os, specifier, "action_check", t.action_check);
+    }
+    emit_table_definition(os, specifier, "action_value", t.action_value);
+    emit_table_definition(os, specifier, "goto_base", t.goto_rows.base);
+    emit_table_definition(os, specifier, "goto_check", t.goto_rows.check);
+    emit_table_definition(os, specifier, "goto_dest", t.goto_rows.value);
+    emit_table_definition(os, specifier, "rule_length", t.rule_length);
+    emit_table_definition(os, specifier, "rule_lhs", t.rule_lhs);
+    if (!t.alternative_base.empty()) {
+        emit_table_definition(
+            os, specifier, "alternative_base", t.alternative_base);
+        emit_table_definition(
+            os, specifier, "int", "alternative_token", t.alternative_token);
+        emit_table_definition(
+            os, specifier, "alternative_value", t.alternative_value);
+    }
+    os << "} // namespace parser_tables\n\n";
+}
+
+// %table_driven: step/gotof/reduce over packed tables instead of
+// state_N/gotof_N member functions
+void emit_driver_tables(
+    std::ostream&                               os,
+    const GenerateOptions&                      options,
+    const std::map<std::string, Type>&          terminal_types,
+    const std::map<std::string, Type>&          nonterminal_types,
+    const std::vector<std::string>&             tokens,
+    const action_map_type&                      actions,
+    const tgt::parsing_table&                   table,
+    const driver_tables&                        t,
+    const std::map<std::vector<std::string>, int>& stub_indices,
+    out_of_line&                                ool) {
+    const auto& grammar = table.get_grammar();
+
+    // reduce dispatcher: constant arguments let the stubs be inlined;
+    // rules without semantic action share the default case, which reads
+    // the rule tables
+    std::vector<std::pair<std::string, std::vector<size_t>>> reduce_cases;
+    std::map<std::string, size_t> reduce_case_indices;
+    for (size_t id: t.reduced_rules) {
+        const auto& rule = grammar.at(id);
+        auto k = finder(actions, rule);
+        if (!k) {
+            continue; // call_nothing (default)
+        }
+
+        const auto& sa = *k;
+        std::stringstream ss;
+        if (sa.special) {
+            ss << make_special_call_name(
+                terminal_types, nonterminal_types, rule, sa, options);
+        } else {
+            std::vector<std::string> signature;
+            make_signature(
+                nonterminal_types,
+                rule,
+                sa,
+                signature,
+                options.smart_pointer_tag);
+
+            ss << "call_" << *finder(stub_indices, signature) << "_"
+               << normalize_internal_sa_name(sa.name);
+        }
+        ss << "(Nonterminal_" << rule.left().name()
+           << ", /*pop*/ " << rule.right().size();
+        if (!sa.special) {
+            ss << ", /*goto*/ -1";
+            for (const auto& x: sa.source_indices) {
+                ss << ", " << x;
+            }
+        }
+        ss << ")";
+
+        auto j = reduce_case_indices.find(ss.str());
+        if (j == reduce_case_indices.end()) {
+            j = reduce_case_indices.insert(
+                std::make_pair(ss.str(), reduce_cases.size())).first;
+            reduce_cases.push_back(
+                std::make_pair(ss.str(), std::vector<size_t>()));
+        }
+        reduce_cases[(*j).second].second.push_back(id);
+    }
+
+    if (options.profile && options.external_token) {
+        // token values are the user's; shifts are counted by token index
+        stencil(
+            os, R"(
+    static int profile_token(token_type token) {
+        switch (token) {
+$${cases}
+        default: return 0;
+        }
+    }
+
+)",
+            {"cases", [&](std::ostream& os) {
+                    for (size_t i = 0 ; i < tokens.size() ; i++) {
+                        stencil(
+                            os, R"(
+        case ${token}: return ${i};
+)",
+                            {"token", options.token_prefix + tokens[i]},
+                            {"i", i}
+                            );
+                    }
+                }}
+            );
+    }
+
+    // step
+    emit_member_declaration(
+        os, ool, "bool", "step(token_type token, value_arg_type value)");
+    emit_member_declaration(
+        os, ool, "int", "gotof(const table_entry* e, Nonterminal nonterminal)");
+    emit_member_declaration(os, ool, "bool", "reduce(int rule)");
+    if (ool.enabled) {
+        os << "\n";
+    }
+
+    std::ostream& def = ool.enabled ? ool.members : os;
+    def << member_head(
+        ool, "bool", "step(token_type token, value_arg_type value)");
+    emit_table(def, ool, "action_base", t.action_base);
+    if (options.external_token) {
+        emit_table(def, ool, "int", "action_token", t.action_token);
+    } else {
+        emit_table(def, ool, "action_check", t.action_check);
+    }
+    emit_table(def, ool, "action_value", t.action_value);
+    stencil(
+        def, R"(
+
+        int state = stack_top()->entry->no;
+$${debmes:state}
+$${profile:state}
+$${lookup}
+        switch (action & 3) {
+        case 1:
+            // shift
+$${profile:shift}
+            push_stack(/*state*/ action >> 2, move_value(value));
+            return false;
+        case 2:
+            // reduce
+            return ${reduce};
+        case 3:
+            // accept
+            accepted_ = true;
+            accepted_value_ = move_value(stack_top()->value);
+            return false;
+        default:
+            ${syntax_error}
+            error_ = true;
+            return false;
+        }
+    }
+
+$${gotof}
+)",
+        {"syntax_error", report_syntax_error(options)},
+        {"gotof", member_head(
+                ool, "int",
+                "gotof(const table_entry* e, Nonterminal nonterminal)")},
+        {"debmes:state", {
+                options.debug_parser ?
+                    R"(        std::cerr << "state_" << state << " << " << token_label(token) << "\n";
+)" :
+                    ""}},
+        {"profile:state", {
+                options.profile ? "        profile_.states[state]++;\n" : ""}},
+        {"profile:shift", {
+                !options.profile ? "" :
+                options.external_token ?
+                "            profile_.shifts[profile_token(token)]++;\n" :
+                "            profile_.shifts[token]++;\n"}},
+        {"reduce", {
+                options.profile ?
+                "(profile_enter() && profile_reduce(action >> 2, reduce(/*rule*/ action >> 2)))" :
+                "reduce(/*rule*/ action >> 2)"}},
+        {"lookup", {
+                options.external_token ?
+                    R"(        int action = 0;
+        for (int i = action_base[state] ; i < action_base[state + 1] ; i++) {
+            if (action_token[i] == token) {
+                action = action_value[i];
+                break;
+            }
+        }
+
+)" :
+                    R"(        int i = action_base[state] + token;
+        int action = action_check[i] == state ? action_value[i] : 0;
+
+)"}}
+        );
+
+    emit_table(def, ool, "goto_base", t.goto_rows.base);
+    emit_table(def, ool, "goto_check", t.goto_rows.check);
+    emit_table(def, ool, "goto_dest", t.goto_rows.value);
+    stencil(
+        def, R"(
+
+        int i = goto_base[e->no] + nonterminal;
+        assert(goto_check[i] == e->no);
+        return goto_dest[i];
+    }
+
+$${reduce}
+)",
+        {"reduce", member_head(ool, "bool", "reduce(int rule)")}
+        );
+    emit_table(def, ool, "rule_length", t.rule_length);
+    emit_table(def, ool, "rule_lhs", t.rule_lhs);
+    stencil(
+        def, R"(
+
+        switch (rule) {
+$${cases}
+        default:
+            return call_nothing(
+                Nonterminal(rule_lhs[rule]), rule_length[rule], -1);
+        }
+    }
+
+)",
+        {"cases", [&](std::ostream& os) {
+                for (const auto& pair: reduce_cases) {
+                    for (size_t id: pair.second) {
+                        stencil(
+                            os, R"(
+        case ${id}:
+)",
+                            {"id", id}
+                            );
+                    }
+                    stencil(
+                        os, R"(
+            return ${call};
+)",
+                        {"call", pair.first}
+                        );
+                }
+            }}
+        );
+}
+
+// %constexpr: parse_constant runs the tables over a token array in a
+// constant expression; values are kept on plain arrays and semantic
+// actions are called in place, so no Parser object is needed
+void emit_constexpr_parser(
+    std::ostream&                               os,
+    const GenerateOptions&                      options,
+    const std::map<std::string, Type>&          nonterminal_types,
+    const action_map_type&                      actions,
+    const tgt::parsing_table&                   table,
+    const driver_tables&                        t) {
+    const auto& grammar = table.get_grammar();
+
+    // Sequence/Optional live on the parser stack, and Value is not a
+    // literal type
+    std::string unsupported;
+    if (options.typed_stack) {
+        unsupported = "%typed_stack";
+    }
+    for (const auto& pair: actions) {
+        if (pair.second.special) {
+            unsupported = "EBNF rules";
+        }
+    }
+
+    stencil(
+        os, R"(
+// parses tokens[0, n) and stores the accepted value to result; usable in
+// constant expressions when _Value and _SemanticAction are literal types
+// and the semantic action members are constexpr. syntax errors are not
+// recovered
+template <${token_parameter}class _Value, class _SemanticAction,
+          unsigned int _StackSize = 128>
+constexpr bool parse_constant(
+    _SemanticAction& sa, const ${token_type}* tokens, const _Value* values,
+    std::size_t n, _Value& result) {
+$${body}
+}
+
+)",
+        {"token_parameter", options.external_token ? "class _Token, " : ""},
+        {"token_type", options.external_token ? "_Token" : "Token"},
+        {"body", [&](std::ostream& os) {
+                if (!unsupported.empty()) {
+                    stencil(
+                        os, R"(
+    static_assert(sizeof(_Value) == 0,
+                  "parse_constant does not support ${unsupported}");
+    return false;
+)",
+                        {"unsupported", unsupported}
+                        );
+                    return;
+                }
+                stencil(
+                    os, R"(
+    using namespace parser_tables;
+
+    int states[_StackSize] = {};
+    _Value stack[_StackSize] = {};
+    int top = 0;
+    states[0] = ${first_state};
+
+    std::size_t k = 0;
+    while (k < n) {
+        int state = states[top];
+$${lookup}
+        switch (action & 3) {
+        case 1:
+            // shift
+            if (top + 1 == int(_StackSize)) {
+                sa.stack_overflow();
+                return false;
+            }
+            ++top;
+            states[top] = action >> 2;
+            stack[top] = values[k++];
+            break;
+        case 2: {
+            // reduce: the frames from base up are replaced by one
+            int rule = action >> 2;
+            int base = top + 1 - rule_length[rule];
+            if (base == int(_StackSize)) {
+                sa.stack_overflow();
+                return false;
+            }
+            _Value v{};
+            switch (rule) {
+$${cases}
+            default:
+                break;
+            }
+            states[base] =
+                goto_dest[goto_base[states[base - 1]] + rule_lhs[rule]];
+            stack[base] = v;
+            top = base;
+            break;
+        }
+        case 3:
+            // accept
+            result = stack[top];
+            return true;
+        default:
+            sa.syntax_error();
+            return false;
+        }
+    }
+    return false;
+)",
+                    {"first_state", table.first_state()},
+                    {"lookup", {
+                            options.external_token ?
+                            R"(        int action = 0;
+        for (int i = action_base[state] ; i < action_base[state + 1] ; i++) {
+            if (action_token[i] == tokens[k]) {
+                action = action_value[i];
+                break;
+            }
+        }
+)" :
+                            R"(        int i = action_base[state] + tokens[k];
+        int action = action_check[i] == state ? action_value[i] : 0;
+)"}},
+                    {"cases", [&](std::ostream& os) {
+                            for (size_t id: t.reduced_rules) {
+                                const auto& rule = grammar.at(id);
+                                auto k = finder(actions, rule);
+                                if (!k) {
+                                    continue; // value_type()
+                                }
+                                const auto& sa = *k;
+                                stencil(
+                                    os, R"(
+            case ${id}: {
+$${args}
+                ${nonterminal_type} r = sa.${semantic_action_name}(${call_args});
+                sa.upcast(v, r);
+                break;
+            }
+)",
+                                    {"id", id},
+                                    {"args", [&](std::ostream& os) {
+                                            for (size_t l = 0 ; l < sa.args.size() ; l++) {
+                                                stencil(
+                                                    os, R"(
+                ${arg_type} arg${l}{}; sa.downcast(arg${l}, stack[base + ${index}]);
+)",
+                                                    {"arg_type", make_type_name(sa.args[l].type, options.smart_pointer_tag)},
+                                                    {"l", l},
+                                                    {"index", sa.source_indices[l]}
+                                                    );
+                                            }
+                                        }},
+                                    {"nonterminal_type", make_type_name(
+                                            *finder(nonterminal_types,
+                                                    rule.left().name()),
+                                            options.smart_pointer_tag)},
+                                    {"semantic_action_name", normalize_sa_call(sa.name)},
+                                    {"call_args", [&](std::ostream& os) {
+                                            for (size_t l = 0 ; l < sa.args.size() ; l++) {
+                                                os << (l == 0 ? "" : ", ") << "arg" << l;
+                                            }
+                                        }}
+                                    );
+                            }
+                        }}
+                    );
+            }}
+        );
+}
+
+// %glr: Tomita style parsing over a graph structured stack. heads reached
+// in the same state share one node; reductions build a packed forest that
+// is evaluated when a value is needed, so the semantic actions of stacks
+// that die are never called. while one stack is alive and its actions are
+// unique, tokens take the plain LR path with eager semantic actions
+void emit_glr_parser(
+    std::ostream&                               os,
+    const GenerateOptions&                      options,
+    const std::map<std::string, Type>&          nonterminal_types,
+    const action_map_type&                      actions,
+    const tgt::parsing_table&                   table,
+    const driver_tables&                        t,
+    const out_of_line&                          ool,
+    const std::string&                          cxx11) {
+    const auto& grammar = table.get_grammar();
+
+    std::vector<std::string> unsupported;
+    if (options.dont_use_stl) {
+        unsupported.push_back("%dont_use_stl");
+    }
+    if (options.typed_stack) {
+        unsupported.push_back("%typed_stack");
+    }
+    if (options.arena) {
+        unsupported.push_back("%arena");
+    }
+    if (options.profile) {
+        unsupported.push_back("%profile");
+    }
+    if (options.incremental) {
+        unsupported.push_back("%incremental");
+    }
+    if (!options.parallel_element.empty()) {
+        unsupported.push_back("%parallel");
+    }
+    for (const auto& pair: actions) {
+        if (pair.second.special) {
+            unsupported.push_back("EBNF rules");
+            break;
+        }
+    }
+    for (const auto& x: unsupported) {
+        os << "#error %glr does not support " << x << "\n";
+    }
+
+    // a cell holds the preferred action and the ones it won over
+    size_t max_actions = 1;
+    for (const auto& state: table.states()) {
+        std::map<int, size_t> counts;
+        for (const auto& pair: state.alternatives) {
+            max_actions = (std::max)(max_actions, ++counts[pair.first] + 1);
+        }
+    }
+    int max_length = 1;
+    for (int x: t.rule_length) {
+        max_length = (std::max)(max_length, x);
+    }
+
+    stencil(
+        os, R"(
+// syntax errors are not recovered. ambiguities are resolved by the
+// semantic action: sa.merge(x, y) folds the value y of another derivation
+// of the same nonterminal over the same tokens into x
+template <${token_parameter}class _Value, class _SemanticAction,
+          unsigned int _StackSize = 0>
+class Parser {
+public:
+    typedef ${token_source} token_type;
+    typedef _Value value_type;
+    typedef typename move_traits<value_type>::arg_type value_arg_type;
+
+    enum Nonterminal {
+$${nonterminals}
+    };
+
+public:
+    Parser(_SemanticAction& sa) : sa_(&sa), args_(${max_length}) {
+        serial_ = 0;
+        reset();
+    }
+
+    ~Parser() {
+        clear();
+        for (size_t i = 0 ; i < free_nodes_.size() ; i++) {
+            delete free_nodes_[i];
+        }
+        for (size_t i = 0 ; i < free_symbols_.size() ; i++) {
+            delete free_symbols_[i];
+        }
+    }
+
+    void reset() {
+        error_ = false;
+        accepted_ = false;
+        clear();
+        heads_.push_back(new_node(${first_state}));
+    }
+
+    // rebinds the parser to another semantic action; nodes and symbols
+    // stay in the free lists for the next parse
+    void reset(_SemanticAction& sa) {
+        sa_ = &sa;
+        reset();
+    }
+
+#if ${cxx11}
+    bool post(token_type token, const value_type& value) {
+        value_type v(value);
+        return post(token, move_value(v));
+    }
+
+#endif
+    bool post(token_type token, value_arg_type value) {
+        if (accepted_ || error_) { return true; }
+        token_ = token;
+        if (heads_.size() != 1 || !run_deterministic(move_value(value))) {
+            materialize();
+            symbol* shifted = new_symbol();
+            shifted->value = move_value(value);
+            run_nondeterministic(shifted);
+            release_symbol(shifted);
+        }
+        return accepted_ || error_;
+    }
+
+    // posts tokens of [first, last) until accepted or a syntax error;
+    // returns the iterator of the token that stopped the parse, or last
+    template <class Iterator, class TokenOf, class ValueOf>
+    Iterator post_range(Iterator first, Iterator last,
+                        TokenOf token_of, ValueOf value_of) {
+        for (; first != last ; ++first) {
+            value_type value(value_of(*first));
+            if (post(token_of(*first), move_value(value))) {
+                break;
+            }
+        }
+        return first;
+    }
+
+    // pull mode: token = lexer.next(value) is read until accepted or a
+    // syntax error
+    template <class Lexer>
+    bool parse(Lexer& lexer, value_type& v) {
+        for (;;) {
+            value_type value;
+            token_type token = lexer.next(value);
+            if (post(token, move_value(value))) {
+                break;
+            }
+        }
+        return !error_ && accept(v);
+    }
+
+    bool accept(value_type& v) {
+        assert(accepted_);
+        if (error_) { return false; }
+        v = move_value(accepted_value_);
+        return true;
+    }
+
+    bool error() { return error_; }
+
+    // number of stacks alive, more than one inside an ambiguity
+    size_t heads() const { return heads_.size(); }
+
+)",
+        {"token_parameter", options.external_token ? "class _Token, " : ""},
+        {"token_source", options.external_token ? "_Token" : "Token"},
+        {"nonterminals", [&](std::ostream& os) {
+                for (const auto& pair: nonterminal_types) {
+                    os << "        Nonterminal_" << pair.first << ",\n";
+                }
+            }},
+        {"max_length", max_length},
+        {"first_state", table.first_state()},
+        {"cxx11", cxx11}
+        );
+
+    stencil(
+        os, R"(
+private:
+    Parser(const Parser&);
+    void operator=(const Parser&);
+
+    // a forest node: the value of a token or a reduced nonterminal, or
+    // while unresolved, the derivations giving it
+    struct symbol {
+        int                     refs;
+        bool                    resolved;
+        int                     rule;           // -1: children[0] as is
+        value_type              value;
+        std::vector<symbol*>    children;
+        symbol*                 alternative;    // next packed derivation
+    };
+
+    // a stack node: the state of the stacks meeting here; each link goes
+    // down to a predecessor, over the symbol between them
+    struct node;
+    struct group;
+    struct link {
+        node*   pred;
+        symbol* sym;
+        size_t  serial;
+    };
+    struct node {
+        int                 state;
+        int                 refs;
+        bool                frontier;
+        group*              fused;
+        std::vector<link>   links;
+    };
+
+    // nullable rules can link nodes of one token into cycles; such nodes
+    // are counted and freed together, refs being those from outside
+    struct group {
+        int                 refs;
+        std::vector<node*>  members;
+    };
+
+    // while one stack is alive, its top is a plain LR stack on heads_[0]
+    struct frame {
+        int         state;
+        value_type  value;
+    };
+
+    struct shift {
+        node*   from;
+        int     state;
+    };
+
+    struct reduction {
+        int                     rule;
+        node*                   end;
+        std::vector<symbol*>    args;
+    };
+
+    _SemanticAction*        sa_;
+    bool                    accepted_;
+    bool                    error_;
+    value_type              accepted_value_;
+    token_type              token_;
+    std::vector<node*>      heads_;         // one per state
+    std::vector<frame>      frames_;
+    std::vector<node*>      frontier_;      // nodes of the token reduced on
+    size_t                  acted_;         // frontier_[0, acted_) acted on
+    std::vector<shift>      shifts_;
+    node*                   accepting_;
+    bool                    cyclic_;        // frontier_ nodes linked
+    size_t                  serial_;        // links in creation order
+    std::vector<value_type> args_;
+    std::vector<node*>      free_nodes_;
+    std::vector<symbol*>    free_symbols_;
+    std::vector<node*>      dead_nodes_;
+    std::vector<symbol*>    dead_symbols_;
+
+    void clear() {
+        frames_.clear();
+        for (size_t i = 0 ; i < heads_.size() ; i++) {
+            release_node(heads_[i]);
+        }
+        heads_.clear();
+    }
+
+    node* new_node(int state) {
+        node* x;
+        if (free_nodes_.empty()) {
+            x = new node;
+        } else {
+            x = free_nodes_.back();
+            free_nodes_.pop_back();
+        }
+        x->state = state;
+        x->refs = 1;
+        x->frontier = false;
+        x->fused = 0;
+        return x;
+    }
+
+    symbol* new_symbol() {
+        symbol* s;
+        if (free_symbols_.empty()) {
+            s = new symbol;
+        } else {
+            s = free_symbols_.back();
+            free_symbols_.pop_back();
+        }
+        s->refs = 1;
+        s->resolved = true;
+        s->rule = -1;
+        s->alternative = 0;
+        return s;
+    }
+
+    void add_link(node* x, node* pred, symbol* s) {
+        link l;
+        l.pred = pred;
+        l.sym = s;
+        l.serial = serial_++;
+        x->links.push_back(l);
+        retain(pred);
+        s->refs++;
+    }
+
+    static void retain(node* x) {
+        if (x->fused) {
+            x->fused->refs++;
+        } else {
+            x->refs++;
+        }
+    }
+
+    void release_node(node* x) {
+        if (!unref(x)) { return; }
+        dead_nodes_.push_back(x);
+        while (!dead_nodes_.empty()) {
+            node* y = dead_nodes_.back();
+            dead_nodes_.pop_back();
+            if (!y->fused) {
+                free_node(y);
+                continue;
+            }
+
+            group* g = y->fused;
+            for (size_t i = 0 ; i < g->members.size() ; i++) {
+                free_node(g->members[i]);
+            }
+            delete g;
+        }
+    }
+
+    // true when the last reference is gone
+    static bool unref(node* x) {
+        return x->fused ? --x->fused->refs == 0 : --x->refs == 0;
+    }
+
+    void free_node(node* y) {
+        for (size_t i = 0 ; i < y->links.size() ; i++) {
+            release_symbol(y->links[i].sym);
+            node* pred = y->links[i].pred;
+            if ((!pred->fused || pred->fused != y->fused) && unref(pred)) {
+                dead_nodes_.push_back(pred);
+            }
+        }
+        y->links.clear();
+        free_nodes_.push_back(y);
+    }
+
+    // links inside the group stop counting as references
+    void fuse() {
+        group* g = new group;
+        g->refs = 0;
+        g->members = frontier_;
+        for (size_t i = 0 ; i < frontier_.size() ; i++) {
+            frontier_[i]->fused = g;
+            g->refs += frontier_[i]->refs;
+        }
+        for (size_t i = 0 ; i < frontier_.size() ; i++) {
+            node* x = frontier_[i];
+            for (size_t j = 0 ; j < x->links.size() ; j++) {
+                if (x->links[j].pred->fused == g) {
+                    g->refs--;
+                }
+            }
+        }
+    }
+
+    void release_symbol(symbol* s) {
+        if (--s->refs != 0) { return; }
+        dead_symbols_.push_back(s);
+        while (!dead_symbols_.empty()) {
+            symbol* y = dead_symbols_.back();
+            dead_symbols_.pop_back();
+            for (size_t i = 0 ; i < y->children.size() ; i++) {
+                if (--y->children[i]->refs == 0) {
+                    dead_symbols_.push_back(y->children[i]);
+                }
+            }
+            if (y->alternative && --y->alternative->refs == 0) {
+                dead_symbols_.push_back(y->alternative);
+            }
+            y->children.clear();
+            y->alternative = 0;
+            y->value = value_type();
+            free_symbols_.push_back(y);
+        }
+    }
+
+    // evaluates the derivations of s; values referred to from nowhere
+    // else are moved
+    void resolve(symbol* s) {
+        if (s->resolved) { return; }
+        for (symbol* a = s ; a ; a = a->alternative) {
+            std::vector<value_type> args(a->children.size() + 1);
+            for (size_t i = 0 ; i < a->children.size() ; i++) {
+                symbol* c = a->children[i];
+                resolve(c);
+                if (c->refs == 1) {
+                    args[i] = move_value(c->value);
+                } else {
+                    args[i] = c->value;
+                }
+            }
+            value_type v;
+            if (a->rule < 0) {
+                v = move_value(args[0]);
+            } else {
+                reduce_value(a->rule, &args[0], v);
+            }
+            if (a == s) {
+                s->value = move_value(v);
+            } else {
+$${merge}
+            }
+        }
+
+        for (size_t i = 0 ; i < s->children.size() ; i++) {
+            release_symbol(s->children[i]);
+        }
+        s->children.clear();
+        if (s->alternative) {
+            release_symbol(s->alternative);
+            s->alternative = 0;
+        }
+        s->resolved = true;
+    }
+
+    // another derivation of x
+    void pack(symbol* x, symbol* s) {
+        if (x->resolved) {
+            // reduced on the LR path; its value is a derivation by itself
+            symbol* v = new_symbol();
+            v->value = move_value(x->value);
+            x->resolved = false;
+            x->rule = -1;
+            x->children.push_back(v);
+        }
+        s->alternative = x->alternative;
+        x->alternative = s;
+    }
+
+    void accept_value(node* x) {
+        symbol* s = x->links[0].sym;
+        resolve(s);
+        accepted_value_ = move_value(s->value);
+        accepted_ = true;
+    }
+
+    // plain LR on the only stack; returns false, having done the steps it
+    // could, when the token forks the stack
+    bool run_deterministic(value_arg_type value) {
+        for (;;) {
+            int state = frames_.empty() ?
+                heads_[0]->state : frames_.back().state;
+            int actions[${max_actions}];
+            int n = actions_of(state, token_, actions);
+            if (n == 0) {
+                sa_->syntax_error();
+                error_ = true;
+                return true;
+            }
+            if (n != 1) { return false; }
+
+            switch (actions[0] & 3) {
+            case 1:
+                // shift
+                frames_.resize(frames_.size() + 1);
+                frames_.back().state = actions[0] >> 2;
+                frames_.back().value = move_value(value);
+                return true;
+            case 2:
+                // reduce
+                if (!reduce_frames(actions[0] >> 2)) { return false; }
+                break;
+            default:
+                // accept
+                if (frames_.empty()) {
+                    accept_value(heads_[0]);
+                } else {
+                    accepted_value_ = move_value(frames_.back().value);
+                    accepted_ = true;
+                }
+                return true;
+            }
+        }
+    }
+
+    bool reduce_frames(int rule) {
+        int length = length_of(rule);
+        int below = length - int(frames_.size());
+        if (below <= 0) {
+            size_t base = frames_.size() - length;
+            for (int i = 0 ; i < length ; i++) {
+                args_[i] = move_value(frames_[base + i].value);
+            }
+            int state = base == 0 ? heads_[0]->state : frames_[base - 1].state;
+            frames_.resize(base + 1);
+            frames_[base].state = goto_of(state, lhs_of(rule));
+            reduce_value(rule, &args_[0], frames_[base].value);
+            return true;
+        }
+
+        // the rest of the right hand side is on the stack graph, which
+        // must not branch there
+        node* head = heads_[0];
+        node* p = head;
+        for (int i = 0 ; i < below ; i++) {
+            if (p->links.size() != 1) { return false; }
+            p = p->links[0].pred;
+        }
+
+        // values of nodes dying with the head are moved
+        node* x = head;
+        bool owned = true;
+        for (int i = below ; 0 < i ; i--) {
+            symbol* s = x->links[0].sym;
+            owned = owned && x->refs == 1 && !x->fused;
+            resolve(s);
+            if (owned && s->refs == 1) {
+                args_[i - 1] = move_value(s->value);
+            } else {
+                args_[i - 1] = s->value;
+            }
+            x = x->links[0].pred;
+        }
+        for (size_t i = 0 ; i < frames_.size() ; i++) {
+            args_[below + i] = move_value(frames_[i].value);
+        }
+
+        retain(p);
+        heads_[0] = p;
+        release_node(head);
+        frames_.resize(1);
+        frames_[0].state = goto_of(p->state, lhs_of(rule));
+        reduce_value(rule, &args_[0], frames_[0].value);
+        return true;
+    }
+
+    // the frames become stack nodes, as the token forks the stack
+    void materialize() {
+        for (size_t i = 0 ; i < frames_.size() ; i++) {
+            node* x = new_node(frames_[i].state);
+            symbol* s = new_symbol();
+            s->value = move_value(frames_[i].value);
+            add_link(x, heads_[0], s);
+            release_symbol(s);
+            release_node(heads_[0]);
+            heads_[0] = x;
+        }
+        frames_.clear();
+    }
+
+    // reduces every head as far as it goes, then shifts the token onto
+    // the heads taking it
+    void run_nondeterministic(symbol* shifted) {
+        frontier_.swap(heads_);
+        for (size_t i = 0 ; i < frontier_.size() ; i++) {
+            frontier_[i]->frontier = true;
+        }
+        shifts_.clear();
+        accepting_ = 0;
+        cyclic_ = false;
+        for (acted_ = 0 ; acted_ < frontier_.size() ; ) {
+            node* x = frontier_[acted_++];
+            act(x, 0, 0);
+        }
+
+        for (size_t i = 0 ; i < shifts_.size() ; i++) {
+            node* w = find_node(heads_, shifts_[i].state);
+            if (!w) {
+                w = new_node(shifts_[i].state);
+                heads_.push_back(w);
+            }
+            add_link(w, shifts_[i].from, shifted);
+        }
+
+        if (accepting_) {
+            accept_value(accepting_);
+        } else if (heads_.empty()) {
+            sa_->syntax_error();
+            error_ = true;
+        }
+
+        if (cyclic_) {
+            fuse();
+        }
+        for (size_t i = 0 ; i < frontier_.size() ; i++) {
+            frontier_[i]->frontier = false;
+        }
+        for (size_t i = 0 ; i < frontier_.size() ; i++) {
+            release_node(frontier_[i]);
+        }
+        frontier_.clear();
+    }
+
+    static node* find_node(const std::vector<node*>& nodes, int state) {
+        for (size_t i = 0 ; i < nodes.size() ; i++) {
+            if (nodes[i]->state == state) { return nodes[i]; }
+        }
+        return 0;
+    }
+
+    // the actions of x; given via, only the reductions over the link
+    // via->links[via_link], which x has not seen yet
+    void act(node* x, node* via, size_t via_link) {
+        int actions[${max_actions}];
+        int n = actions_of(x->state, token_, actions);
+
+        // the paths are collected first, as reducing adds links
+        std::vector<reduction> reductions;
+        for (int i = 0 ; i < n ; i++) {
+            switch (actions[i] & 3) {
+            case 1:
+                if (!via) {
+                    shift s;
+                    s.from = x;
+                    s.state = actions[i] >> 2;
+                    shifts_.push_back(s);
+                }
+                break;
+            case 2: {
+                reduction r;
+                r.rule = actions[i] >> 2;
+                r.args.resize(length_of(r.rule));
+                if (via && r.args.empty()) { break; }
+                size_t newest = via ? via->links[via_link].serial : serial_;
+                find_paths(
+                    x, int(r.args.size()), !via, via, via_link, newest, r,
+                    reductions);
+                break;
+            }
+            default:
+                if (!via) { accepting_ = x; }
+                break;
+            }
+        }
+
+        for (size_t i = 0 ; i < reductions.size() ; i++) {
+            reduce_path(reductions[i]);
+        }
+    }
+
+    // a path through via takes no link newer than it, so that each path
+    // is found once however the links came
+    void find_paths(
+        node* x, int depth, bool through, node* via, size_t via_link,
+        size_t newest, reduction& r, std::vector<reduction>& paths) {
+        if (depth == 0) {
+            if (through) {
+                r.end = x;
+                paths.push_back(r);
+            }
+            return;
+        }
+        for (size_t i = 0 ; i < x->links.size() ; i++) {
+            if (newest < x->links[i].serial) { continue; }
+            r.args[depth - 1] = x->links[i].sym;
+            find_paths(
+                x->links[i].pred, depth - 1,
+                through || (x == via && i == via_link), via, via_link,
+                newest, r, paths);
+        }
+    }
+
+    void reduce_path(const reduction& r) {
+        symbol* s = new_symbol();
+        s->resolved = false;
+        s->rule = r.rule;
+        s->children = r.args;
+        for (size_t i = 0 ; i < r.args.size() ; i++) {
+            r.args[i]->refs++;
+        }
+
+        cyclic_ = cyclic_ || r.end->frontier;
+
+        int state = goto_of(r.end->state, lhs_of(r.rule));
+        node* w = find_node(frontier_, state);
+        if (!w) {
+            w = new_node(state);
+            w->frontier = true;
+            frontier_.push_back(w);
+            add_link(w, r.end, s);
+            release_symbol(s);
+            return;
+        }
+
+        for (size_t i = 0 ; i < w->links.size() ; i++) {
+            if (w->links[i].pred == r.end) {
+                // the same nonterminal over the same tokens
+                pack(w->links[i].sym, s);
+                return;
+            }
+        }
+
+        add_link(w, r.end, s);
+        release_symbol(s);
+
+        // nodes acted on have missed the paths over the new link
+        size_t k = w->links.size() - 1;
+        for (size_t i = 0 ; i < acted_ ; i++) {
+            act(frontier_[i], w, k);
+        }
+    }
+
+    // the action of the LALR table, then the ones its conflicts left out
+    int actions_of(int state, token_type token, int* actions) const {
+$${action_tables}
+
+$${lookup}
+        int n = 0;
+        if (action != 0) {
+            actions[n++] = action;
+        }
+        for (int j = alternative_base[state] ;
+             j < alternative_base[state + 1] ; j++) {
+            if (alternative_token[j] == token) {
+                actions[n++] = alternative_value[j];
+            }
+        }
+        return n;
+    }
+
+    int goto_of(int state, int nonterminal) const {
+$${goto_tables}
+
+        int i = goto_base[state] + nonterminal;
+        assert(goto_check[i] == state);
+        return goto_dest[i];
+    }
+
+    int length_of(int rule) const {
+$${rule_length}
+        return rule_length[rule];
+    }
+
+    int lhs_of(int rule) const {
+$${rule_lhs}
+        return rule_lhs[rule];
+    }
+
+    void reduce_value(int rule, value_type* args, value_type& v) {
+        (void)args;
+        switch (rule) {
+$${cases}
+        default:
+            v = value_type();
+            break;
+        }
+    }
+
+};
+
+)",
+        {"max_actions", max_actions},
+        {"merge", {
+                max_actions == 1 ?
+                "                assert(0); // nothing is packed without conflicts\n" :
+                "                sa_->merge(s->value, move_value(v));\n"}},
+        {"action_tables", [&](std::ostream& os) {
+                emit_table(os, ool, "action_base", t.action_base);
+                if (options.external_token) {
+                    emit_table(os, ool, "int", "action_token", t.action_token);
+                } else {
+                    emit_table(os, ool, "action_check", t.action_check);
+                }
+                emit_table(os, ool, "action_value", t.action_value);
+                emit_table(os, ool, "alternative_base", t.alternative_base);
+                emit_table(
+                    os, ool, "int", "alternative_token", t.alternative_token);
+                emit_table(os, ool, "alternative_value", t.alternative_value);
+            }},
+        {"lookup", {
+                options.external_token ?
+                    R"(        int action = 0;
+        for (int i = action_base[state] ; i < action_base[state + 1] ; i++) {
+            if (action_token[i] == token) {
+                action = action_value[i];
+                break;
+            }
+        }
+)" :
+                    R"(        int i = action_base[state] + token;
+        int action = action_check[i] == state ? action_value[i] : 0;
+)"}},
+        {"goto_tables", [&](std::ostream& os) {
+                emit_table(os, ool, "goto_base", t.goto_rows.base);
+                emit_table(os, ool, "goto_check", t.goto_rows.check);
+                emit_table(os, ool, "goto_dest", t.goto_rows.value);
+            }},
+        {"rule_length", [&](std::ostream& os) {
+                emit_table(os, ool, "rule_length", t.rule_length);
+            }},
+        {"rule_lhs", [&](std::ostream& os) {
+                emit_table(os, ool, "rule_lhs", t.rule_lhs);
+            }},
+        {"cases", [&](std::ostream& os) {
+                if (!unsupported.empty()) {
+                    return;
+                }
+                for (size_t id: t.reduced_rules) {
+                    const auto& rule = grammar.at(id);
+                    auto k = finder(actions, rule);
+                    if (!k) {
+                        continue; // value_type()
+                    }
+                    const auto& sa = *k;
+                    stencil(
+                        os, R"(
+        case ${id}: {
+$${args}
+            ${nonterminal_type} r = sa_->${semantic_action_name}(${call_args});
+            sa_->upcast(v, move_value(r));
+            break;
+        }
+)",
+                        {"id", id},
+                        {"args", [&](std::ostream& os) {
+                                for (size_t l = 0 ; l < sa.args.size() ; l++) {
+                                    stencil(
+                                        os, R"(
+            ${arg_type} arg${l}; sa_->downcast(arg${l}, move_value(args[${index}]));
+)",
+                                        {"arg_type", make_type_name(sa.args[l].type, options.smart_pointer_tag)},
+                                        {"l", l},
+                                        {"index", sa.source_indices[l]}
+                                        );
+                                }
+                            }},
+                        {"nonterminal_type", make_type_name(
+                                *finder(nonterminal_types, rule.left().name()),
+                                options.smart_pointer_tag)},
+                        {"semantic_action_name", normalize_sa_call(sa.name)},
+                        {"call_args", [&](std::ostream& os) {
+                                for (size_t l = 0 ; l < sa.args.size() ; l++) {
+                                    os << (l == 0 ? "" : ", ") << "arg" << l;
+                                }
+                            }}
+                        );
+                }
+            }}
+        );
+}
+
+// %incremental: the public reparse; the parser keeps the tree of the last
+// accepted parse and links its unchanged subtrees into the next one
+void emit_incremental_api(
+    std::ostream& os, const tgt::parsing_table& table) {
+    stencil(
+        os, R"(
+    // %incremental: [first, last) is the whole token sequence, ending with
+    // eof, after the tokens [edit, edit + removed) of the last accepted
+    // parse were replaced by the ones now at [edit, edit + inserted). The
+    // stack is rebuilt as it was when the token at edit was read; past the
+    // edit, an old subtree starting at the token just shifted is pushed
+    // whole if it was built on a frame in the same state, so the work
+    // follows the size of the edit rather than of the input. Reused
+    // subtrees keep their values: semantic actions must depend on their
+    // arguments only. Without a tree (after reset(), or a parse that
+    // recovered from a syntax error) every token is parsed again
+    template <class Iterator, class TokenOf, class ValueOf>
+    bool reparse(Iterator first, Iterator last,
+                 TokenOf token_of, ValueOf value_of,
+                 size_t edit, size_t removed, size_t inserted,
+                 value_type& v) {
+        int old = root_;
+        if (old < 0) {
+            reset();
+            post_range(first, last, token_of, value_of);
+            return accepted_ && accept(v);
+        }
+        if (collected_ == 0) { collected_ = nodes_.size(); }
+        if (collected_ * 2 < nodes_.size()) { old = collect(old); }
+        assert(edit + removed <= size_t(nodes_[old].length));
+
+        error_ = false;
+        accepted_ = false;
+        root_ = -1;
+        clear_stack();
+        rollback_tmp_stack();
+        push_stack(${first_state}, value_type());
+        restore(old, edit);
+        commit_tmp_stack();
+
+        cursor_.clear();
+        cursor_.push_back(cursor_entry(old, 0, nodes_[old].length));
+        size_t n = size_t(last - first);
+        for (size_t p = edit ; p < n && !error_ ; ) {
+            value_type value(value_of(first[p]));
+            if (post(token_of(first[p]), move_value(value))) {
+                break;
+            }
+            int x = -1;
+            if (edit + inserted <= p && !recovered_) {
+                x = reusable(p - inserted + removed, state_of(
+                                 stack_.nth(stack_.depth() - 2).node));
+            }
+            if (x < 0) {
+                p++;
+                continue;
+            }
+            // the subtree replaces the token it starts with
+            stack_.pop(1);
+            if (push_node(x)) {
+                commit_tmp_stack();
+            }
+            p += nodes_[x].length;
+        }
+        return accepted_ && accept(v);
+    }
+
+)",
+        {"first_state", table.first_state()}
+        );
+}
+
+void emit_incremental_members(
+    std::ostream& os, const tgt::parsing_table& table) {
+    stencil(
+        os, R"(
+    // %incremental: every frame pushed gets a node. Nodes are appended to
+    // nodes_ and never changed, children before their parents, so a new
+    // tree can share subtrees with the old one; collect() drops the nodes
+    // root_ no longer reaches
+    struct tree_node {
+        int         state;  // of the frame holding the node
+        int         entry;  // of the frame below it
+        int         length; // tokens covered
+        int         kids;   // children are kids_[kids, kids + arity)
+        int         arity;
+        value_type  value;
+    };
+
+    // a path of the old tree down to the token being reused from
+    struct cursor_entry {
+        int         node;
+        size_t      begin;
+        size_t      end;
+        int         kid;        // child on the path, or the next one
+        size_t      kid_begin;
+
+        cursor_entry(int x, size_t b, size_t e)
+            : node(x), begin(b), end(e), kid(0), kid_begin(b) {}
+    };
+
+    std::vector<tree_node>      nodes_;
+    std::vector<int>            kids_;
+    std::vector<cursor_entry>   cursor_;
+    int                         root_;
+    int                         pending_;   // kids_ of the reduction, or -1
+    size_t                      collected_; // nodes_ left by collect()
+    bool                        recovered_;
+
+    int state_of(int x) {
+        return x < 0 ? ${first_state} : nodes_[x].state;
+    }
+
+    void record_node(int state_index) {
+        // the frame just pushed holds a token, or the nonterminal reduced
+        // from the frames pop_stack noted; the bottom frame has no node
+        size_t d = stack_.depth();
+        if (d == 1) { return; }
+        stack_top()->node = int(nodes_.size());
+        nodes_.push_back(tree_node());
+        tree_node& n = nodes_.back();
+        n.state = state_index;
+        n.entry = state_of(stack_.nth(d - 2).node);
+        n.length = 1;
+        n.kids = 0;
+        n.arity = 0;
+        if (0 <= pending_) {
+            n.kids = pending_;
+            n.arity = int(kids_.size()) - pending_;
+            n.length = 0;
+            for (int k = 0 ; k < n.arity ; k++) {
+                n.length += nodes_[kids_[n.kids + k]].length;
+            }
+            pending_ = -1;
+        }
+        n.value = stack_top()->value;
+    }
+
+    void note_children(size_t n) {
+        pending_ = int(kids_.size());
+        for (size_t i = stack_.depth() - n ; i < stack_.depth() ; i++) {
+            kids_.push_back(stack_.nth(i).node);
+        }
+    }
+
+    bool push_node(int x) {
+        // a node of the old tree goes back on the stack as it is
+        value_type v(nodes_[x].value);
+        stack_frame f(entry(nodes_[x].state), move_value(v), 0);
+        f.node = x;
+        if (!stack_.push(move_value(f))) {
+            error_ = true;
+            sa_->stack_overflow();
+            return false;
+        }
+        return true;
+    }
+
+    void restore(int x, size_t edit) {
+        // the frames on the stack when the token at edit was read: the
+        // nodes ending before it, and the token ending at it. A
+        // nonterminal ending at edit was reduced on that token, so it is
+        // opened instead
+        size_t p = 0;
+        if (edit == 0) { return; }
+        while (0 <= x && !error_) {
+            const tree_node& n = nodes_[x];
+            x = -1;
+            for (int k = 0 ; k < n.arity && p < edit ; k++) {
+                int c = kids_[n.kids + k];
+                size_t end = p + nodes_[c].length;
+                if (edit < end || (end == edit && 0 < nodes_[c].arity)) {
+                    x = c;
+                    break;
+                }
+                if (!push_node(c)) { break; }
+                p = end;
+            }
+        }
+    }
+
+    int reusable(size_t b, int state) {
+        // the outermost node of the old tree that starts at the token b
+        // and was pushed on a frame in state; b only grows within a
+        // reparse, so the path moves forward through the tree
+        while (!cursor_.empty() && cursor_.back().end <= b) {
+            cursor_.pop_back();
+        }
+        if (cursor_.empty()) { return -1; }
+        for (;;) {
+            cursor_entry& e = cursor_.back();
+            const tree_node& n = nodes_[e.node];
+            if (n.arity == 0) { break; }
+            int c = kids_[n.kids + e.kid];
+            while (e.kid_begin + nodes_[c].length <= b) {
+                e.kid_begin += nodes_[c].length;
+                c = kids_[n.kids + ++e.kid];
+            }
+            size_t begin = e.kid_begin;
+            cursor_.push_back(
+                cursor_entry(c, begin, begin + nodes_[c].length));
+        }
+        size_t i = cursor_.size() - 1;
+        while (0 < i && cursor_[i - 1].begin == b) { i--; }
+        for (; i < cursor_.size() ; i++) {
+            const tree_node& n = nodes_[cursor_[i].node];
+            if (0 < n.arity && n.entry == state) { return cursor_[i].node; }
+        }
+        return -1;
+    }
+
+    int collect(int root) {
+        // keeps the nodes reachable from root; children come before their
+        // parents, so one pass in order renumbers them
+        std::vector<int> index(nodes_.size(), -1);
+        std::vector<int> work(1, root);
+        index[root] = 0;
+        while (!work.empty()) {
+            const tree_node& n = nodes_[work.back()];
+            work.pop_back();
+            for (int k = 0 ; k < n.arity ; k++) {
+                int c = kids_[n.kids + k];
+                if (index[c] < 0) {
+                    index[c] = 0;
+                    work.push_back(c);
+                }
+            }
+        }
+        std::vector<int> kids;
+        size_t m = 0;
+        for (size_t i = 0 ; i < nodes_.size() ; i++) {
+            if (index[i] < 0) { continue; }
+            tree_node& n = nodes_[i];
+            int k0 = int(kids.size());
+            for (int k = 0 ; k < n.arity ; k++) {
+                kids.push_back(index[kids_[n.kids + k]]);
+            }
+            n.kids = k0;
+            index[i] = int(m);
+            if (m != i) { nodes_[m] = move_value(n); }
+            m++;
+        }
+        nodes_.erase(nodes_.begin() + m, nodes_.end());
+        kids_.swap(kids);
+        collected_ = m;
+        return index[root];
+    }
+
+)",
+        {"first_state", table.first_state()}
+        );
+}
+
+// %parallel: the states of the stack between two elements of the sequence,
+// bottom first, and the frame holding its accumulator. The sequence must
+// occur once, in a rule of the start symbol that no rule refers to, so
+// that only its own rules pop that frame before accept
+void find_parallel_path(
+    const GenerateOptions&              options,
+    const std::map<std::string, Type>&  nonterminal_types,
+    const tgt::parsing_table&           table,
+    std::vector<int>&                   path,
+    int&                                accumulator) {
+    const auto& grammar = table.get_grammar();
+    const auto root = grammar.root_rule().right()[0];
+
+    auto is_sequence = [&](const tgt::symbol& x) {
+        if (x.is_terminal()) { return false; }
+        auto type = finder(nonterminal_types, x.name());
+        return type && (*type).name == options.parallel_element &&
+            ((*type).extension == Extension::Star ||
+             (*type).extension == Extension::Plus ||
+             (*type).extension == Extension::Slash);
+    };
+
+    const tgt::rule* found = nullptr;
+    size_t position = 0;
+    int occurrences = 0;
+    bool root_used = false;
+    for (size_t k = 1 ; k < grammar.size() ; k++) {
+        const auto& rule = grammar.at(k);
+        for (size_t i = 0 ; i < rule.right().size() ; i++) {
+            const auto& x = rule.right()[i];
+            if (!x.is_terminal() && x.name() == root.name()) {
+                root_used = true;
+            }
+            // the trailers of a sequence begin with the sequence itself
+            if (is_sequence(x) &&
+                !(i == 0 && x.name() == rule.left().name())) {
+                found = &rule;
+                position = i;
+                occurrences++;
+            }
+        }
+    }
+    if (occurrences != 1 || root_used ||
+        found->left().name() != root.name()) {
+        throw unparallelizable_sequence(
+            options.parallel_addr, options.parallel_element);
+    }
+
+    int s = table.first_state();
+    path.push_back(s);
+    auto step = [&](const tgt::symbol& x) {
+        const auto& state = table.states()[s];
+        if (x.is_terminal()) {
+            auto i = state.action_table.find(x.token());
+            if (i == state.action_table.end() ||
+                (*i).second.type != zw::gr::action_shift) {
+                throw unparallelizable_sequence(
+                    options.parallel_addr, options.parallel_element);
+            }
+            s = (*i).second.dest_index;
+        } else {
+            auto i = state.goto_table.find(x);
+            assert(i != state.goto_table.end());
+            s = (*i).second;
+        }
+        path.push_back(s);
+    };
+
+    const auto sequence = found->right()[position];
+    for (size_t i = 0 ; i <= position ; i++) {
+        step(found->right()[i]);
+    }
+    accumulator = int(path.size()) - 1;
+
+    // '/': between two elements the delimiter has been shifted too
+    if ((*finder(nonterminal_types, sequence.name())).extension ==
+        Extension::Slash) {
+        for (const auto& rule: grammar) {
+            if (rule.left().name() == sequence.name() &&
+                rule.right().size() == 3) {
+                step(rule.right()[1]);
+            }
+        }
+    }
+}
+
+// %parallel: the public parse; chunks of the sequence are parsed on threads
+// of their own and joined in order where their guessed start was right
+void emit_parallel_api(std::ostream& os, const GenerateOptions& options) {
+    stencil(
+        os, R"(
+    // %parallel: [first, last) is the whole token sequence, ending with
+    // eof. The tokens of the ${element} sequence in the start rule are cut
+    // into one chunk per thread, each starting at a token for which
+    // is_boundary() holds, guessed to begin an element. Every chunk past
+    // the first is parsed on a thread of its own, from the stack the
+    // sequence has between two elements, with a copy of the semantic
+    // action; the calling thread parses the first one meanwhile, then goes
+    // on in order. Where the tokens before a chunk did leave that stack,
+    // the elements of the chunk are joined to the sequence with
+    // sa.concat(accumulator, chunk_accumulator); where they did not, or
+    // the chunk met a syntax error, its tokens are posted again. The
+    // element after the last boundary is parsed on the calling thread, so
+    // that no chunk reaches eof. Iterators are random access; token_of,
+    // value_of and the copies of the semantic action are used from several
+    // threads at once.
+    // Only the chunk accumulator is carried back from a copy: whatever else
+    // its actions do is lost when the chunk is joined, and done for nothing
+    // when a wrong guess is posted again (syntax_error() is not called
+    // while speculating). So the result is the one post_range() gives only
+    // if the semantic actions are pure apart from append() and concat()
+    template <class Iterator, class TokenOf, class ValueOf, class IsBoundary>
+    bool parse_parallel(Iterator first, Iterator last,
+                        TokenOf token_of, ValueOf value_of,
+                        IsBoundary is_boundary, unsigned int threads,
+                        value_type& v) {
+        reset();
+        size_t n = size_t(last - first);
+
+        // chunk k is [cuts[k], cuts[k + 1]); the cuts are spread evenly
+        // before the last boundary, each moved forward to a boundary
+        size_t end = n;
+        while (0 < end && !is_boundary(first[--end])) {}
+        std::vector<size_t> cuts(1, 0);
+        for (unsigned int k = 1 ; k < threads ; k++) {
+            size_t p = n * k / threads;
+            if (p <= cuts.back()) { p = cuts.back() + 1; }
+            while (p < end && !is_boundary(first[p])) { p++; }
+            if (end <= p) { break; }
+            cuts.push_back(p);
+        }
+        cuts.push_back(end);
+
+        std::vector<parallel_chunk> chunks(
+            cuts.size() - 1, parallel_chunk(*sa_));
+        std::vector<std::thread> workers;
+        Iterator stop = first + cuts[1];
+        try {
+            for (size_t k = 1 ; k + 1 < cuts.size() ; k++) {
+                parallel_chunk* chunk = &chunks[k];
+                Iterator b = first + cuts[k];
+                Iterator e = first + cuts[k + 1] + 1; // with the probe
+                workers.push_back(std::thread([=]() {
+                            try {
+                                self_type parser(chunk->sa);
+                                chunk->valid = parser.speculate(
+                                    b, e, token_of, value_of,
+                                    chunk->accumulator);
+                            } catch (...) {
+                                // posted again on the calling thread
+                            }
+                        }));
+            }
+            stop = post_range(first, stop, token_of, value_of);
+        } catch (...) {
+            join_workers(workers);
+            throw;
+        }
+        join_workers(workers);
+
+        bool stopped = stop != first + cuts[1];
+        for (size_t k = 1 ; k + 1 < cuts.size() && !stopped ; k++) {
+            // the first token of the chunk shows whether it was guessed
+            // right
+            Iterator b = first + cuts[k];
+            Iterator e = first + cuts[k + 1];
+            value_type value(value_of(*b));
+            if (post(token_of(*b), move_value(value))) {
+                stopped = true;
+                break;
+            }
+            if (chunks[k].valid && at_parallel_boundary()) {
+                pop_stack(1);
+                commit_tmp_stack();
+                sa_->concat(stack_.nth(parallel_accumulator).value,
+                            move_value(chunks[k].accumulator));
+            } else {
+                stopped = post_range(b + 1, e, token_of, value_of) != e;
+            }
+        }
+        if (!stopped) {
+            post_range(first + cuts.back(), last, token_of, value_of);
+        }
+        return accepted_ && accept(v);
+    }
+
+)",
+        {"element", options.parallel_element}
+        );
+}
+
+void emit_parallel_members(
+    std::ostream&           os,
+    const std::vector<int>& path,
+    int                     accumulator,
+    const std::string&      call_state) {
+    stencil(
+        os, R"(
+    // %parallel: set while parsing a chunk on a thread, which reports no
+    // syntax errors; a chunk that meets one is posted again in order
+    bool speculating_;
+
+    // %parallel: a chunk of the sequence and its own semantic action
+    struct parallel_chunk {
+        _SemanticAction sa;
+        value_type      accumulator;
+        bool            valid;
+
+        parallel_chunk(const _SemanticAction& a)
+            : sa(a), accumulator(), valid(false) {}
+    };
+
+    // the stack between two elements of the sequence, bottom first; the
+    // accumulator of the sequence is in frame parallel_accumulator
+    enum {
+        parallel_depth = ${depth},
+        parallel_accumulator = ${accumulator}
+    };
+
+    static int parallel_state(int i) {
+        static const int states[] = { ${states} };
+        return states[i];
+    }
+
+    // true if the token just shifted was shifted on that stack
+    bool at_parallel_boundary() {
+        if (stack_.depth() != size_t(parallel_depth + 1)) {
+            return false;
+        }
+        for (int i = 0 ; i < parallel_depth ; i++) {
+            if (stack_.nth(i).entry != entry(parallel_state(i))) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // parses [first, last) from the stack between two elements, leaving
+    // the elements reduced in accumulator; true if the last token, the
+    // first of the next chunk, was shifted on that stack again. Errors
+    // are not recovered from here: the chunk is posted again in order
+    template <class Iterator, class TokenOf, class ValueOf>
+    bool speculate(Iterator first, Iterator last,
+                   TokenOf token_of, ValueOf value_of,
+                   value_type& accumulator) {
+        speculating_ = true;
+        clear_stack();
+        rollback_tmp_stack();
+        for (int i = 0 ; i < parallel_depth ; i++) {
+            if (!push_stack(parallel_state(i), value_type())) {
+                return false;
+            }
+        }
+        commit_tmp_stack();
+        for (; first != last ; ++first) {
+            token_type token = token_of(*first);
+            value_type value(value_of(*first));
+            rollback_tmp_stack();
+            while (${call_state}(token, move_value(value)))
+                ;
+            if (error_ || accepted_) {
+                return false;
+            }
+            commit_tmp_stack();
+        }
+        if (!at_parallel_boundary()) {
+            return false;
+        }
+        accumulator = move_value(stack_.nth(parallel_accumulator).value);
+        return true;
+    }
+
+    static void join_workers(std::vector<std::thread>& workers) {
+        for (size_t i = 0 ; i < workers.size() ; i++) {
+            workers[i].join();
+        }
+    }
+
+)",
+        {"depth", int(path.size())},
+        {"accumulator", accumulator},
+        {"states", [&](std::ostream& os) {
+                for (size_t i = 0 ; i < path.size() ; i++) {
+                    os << (i ? ", " : "") << path[i];
+                }
+            }},
+        {"call_state", call_state}
+        );
+}
+
+// %recover_sync: the states the error token is shifted into. Recovering
+// from a token such a state has no action on pops it, shifts the error
+// token into it again and discards the token, leaving the stack as it was;
+// skippable() answers that from the table instead, so a run of garbage
+// costs a switch per token rather than a recovery
+void emit_recover_sync(
+    std::ostream&                       os,
+    const GenerateOptions&              options,
+    const std::vector<std::string>&     tokens,
+    const tgt::parsing_table&           table) {
+    std::set<int> targets;
+    for (const auto& state: table.states()) {
+        for (const auto& pair: state.action_table) {
+            if (tokens[pair.first] == options.recovery_token &&
+                pair.second.type == zw::gr::action_shift) {
+                targets.insert(pair.second.dest_index);
+            }
+        }
+    }
+
+    stencil(
+        os, R"(
+    // %recover_sync: set by recover() when it discarded a token; tokens
+    // the state on the top cannot take are skipped until one it can
+    bool syncing_;
+
+)"
+        );
+
+    std::stringstream cases;
+    for (int i: targets) {
+        const auto& state = table.states()[i];
+        // a state taking the error token itself is left to recover()
+        if (state.handle_error) {
+            continue;
+        }
+        stencil(
+            cases, R"(
+        case ${i}:
+            switch (token) {
+)",
+            {"i", i}
+            );
+        std::set<int> takes;
+        takes.insert(0); // eof
+        for (const auto& pair: state.action_table) {
+            takes.insert(pair.first);
+        }
+        for (int token: takes) {
+            stencil(
+                cases, R"(
+            case ${token}:
+)",
+                {"token", options.token_prefix + tokens[token]}
+                );
+        }
+        stencil(
+            cases, R"(
+                return false;
+            default:
+                return true;
+            }
+)"
+            );
+    }
+
+    if (cases.str().empty()) {
+        stencil(
+            os, R"(
+    bool skippable(token_type) { return false; }
+
+)"
+            );
+        return;
+    }
+    stencil(
+        os, R"(
+    bool skippable(token_type token) {
+        switch (int(stack_top()->entry - entry(0))) {
+$${cases}
+        default:
+            return false;
+        }
+    }
+
+)",
+        {"cases", cases.str()}
+        );
+}
+
+// %lex: runs of bytes a state loops on are skipped by SIMD kernels when the
+// run, or what ends it, is a few byte ranges (blanks, identifier tails,
+// string and comment bodies); CAPER_LEX_SIMD picks the instruction set,
+// 0 keeps the scalar loop
+struct lex_run {
+    std::vector<std::pair<int, int>>    ranges;
+    bool                                negated;    // ranges end the run
+};
+
+std::vector<std::pair<int, int>> byte_ranges(const std::vector<bool>& s) {
+    std::vector<std::pair<int, int>> ranges;
+    for (int b = 0 ; b < 256 ; b++) {
+        if (!s[b]) { continue; }
+        if (!ranges.empty() && ranges.back().second == b - 1) {
+            ranges.back().second = b;
+        } else {
+            ranges.push_back(std::make_pair(b, b));
+        }
+    }
+    return ranges;
+}
+
+// the bytes state s loops on, if a kernel can test them
+bool find_lex_run(const LexDfa& dfa, int s, lex_run& run) {
+    const size_t max_ranges = 4;
+    std::vector<bool> in(256), out(256);
+    bool loops = false;
+    for (int b = 0 ; b < 256 ; b++) {
+        in[b] = dfa.transitions[s][dfa.byte_class[b]] == s;
+        out[b] = !in[b];
+        loops = loops || in[b];
+    }
+    if (!loops) {
+        return false;
+    }
+    run.ranges = byte_ranges(in);
+    run.negated = false;
+    std::vector<std::pair<int, int>> complement = byte_ranges(out);
+    if (complement.size() < run.ranges.size()) {
+        run.ranges = complement;
+        run.negated = true;
+    }
+    return run.ranges.size() <= max_ranges;
+}
+
+// the kernel of each state of the direct-coded DFA, or -1; states looping
+// on the same bytes share one
+std::vector<int> find_lex_runs(
+    const GenerateOptions&  options,
+    const LexDfa&           dfa,
+    std::vector<lex_run>&   runs) {
+    std::vector<int> run_of(dfa.transitions.size(), -1);
+    if (options.table_driven) {
+        return run_of;
+    }
+    for (size_t s = 0 ; s < dfa.transitions.size() ; s++) {
+        lex_run run;
+        if (!find_lex_run(dfa, int(s), run)) { continue; }
+        for (size_t k = 0 ; k < runs.size() ; k++) {
+            if (runs[k].ranges == run.ranges &&
+                runs[k].negated == run.negated) {
+                run_of[s] = int(k);
+            }
+        }
+        if (run_of[s] < 0) {
+            run_of[s] = int(runs.size());
+            runs.push_back(run);
+        }
+    }
+    return run_of;
+}
+
+std::string lex_run_label(const lex_run& run) {
+    std::ostringstream ss;
+    auto put = [&](int b) {
+        if (isgraph(b) && !strchr("\\]^-", b)) {
+            ss << char(b);
+        } else {
+            ss << "\\x" << "0123456789abcdef"[b / 16]
+               << "0123456789abcdef"[b % 16];
+        }
+    };
+    ss << (run.negated ? "[^" : "[");
+    for (const auto& r: run.ranges) {
+        put(r.first);
+        if (r.first != r.second) {
+            ss << "-";
+            put(r.second);
+        }
+    }
+    ss << "]";
+    return ss.str();
+}
+
+void emit_lex_kernel(std::ostream& os, int k, const lex_run& run) {
+    struct isa {
+        int         level;
+        int         width;
+        const char* vector;
+        const char* load;
+        const char* prefix;     // intrinsics
+        const char* suffix;
+    };
+    bool ranged = false;
+    for (const auto& r: run.ranges) {
+        ranged = ranged || r.first != r.second;
+    }
+    static const isa isas[] = {
+        { 2, 32, "__m256i", "_mm256_loadu_si256((const __m256i*)p)",
+          "_mm256_", "si256" },
+        { 1, 16, "__m128i", "_mm_loadu_si128((const __m128i*)p)",
+          "_mm_", "si128" },
+        { 3, 16, "uint8x16_t", "vld1q_u8((const uint8_t*)p)", "", "" },
+    };
+
+    stencil(
+        os, R"(
+    // skips a run of ${label}
+    static const char* skip_${k}(const char* p, const char* last) {
+)",
+        {"label", lex_run_label(run)},
+        {"k", k}
+        );
+    for (const isa& x: isas) {
+        bool neon = x.level == 3;
+        std::string p = x.prefix;
+        auto set1 = [&](int n) -> std::string {
+            return neon ?
+                "vdupq_n_u8(" + std::to_string(n) + ")" :
+                p + "set1_epi8(char(" + std::to_string(n) + "))";
+        };
+        auto eq = [&](const std::string& a, const std::string& b) {
+            return neon ?
+                "vceqq_u8(" + a + ", " + b + ")" :
+                p + "cmpeq_epi8(" + a + ", " + b + ")";
+        };
+
+        os << (x.level == 2 ? "#if" : "#elif") << " CAPER_LEX_SIMD == "
+           << x.level << "\n"
+           << "        while (" << x.width << " <= last - p) {\n"
+           << "            " << x.vector << " x = " << x.load << ";\n"
+           << "            " << x.vector << (ranged ? " t, m;\n" : " m;\n");
+        for (size_t i = 0 ; i < run.ranges.size() ; i++) {
+            int lo = run.ranges[i].first;
+            int hi = run.ranges[i].second;
+            std::string test;
+            if (lo == hi) {
+                test = eq("x", set1(lo));
+            } else {
+                os << "            t = "
+                   << (neon ? "vsubq_u8(" : p + "sub_epi8(")
+                   << "x, " << set1(lo) << ");\n";
+                test = neon ?
+                    "vcleq_u8(t, " + set1(hi - lo) + ")" :
+                    eq(p + "min_epu8(t, " + set1(hi - lo) + ")", "t");
+            }
+            if (i == 0) {
+                os << "            m = " << test << ";\n";
+            } else {
+                os << "            m = "
+                   << (neon ? "vorrq_u8(m, " : p + "or_" + x.suffix + "(m, ")
+                   << test << ");\n";
+            }
+        }
+        // a bit for each byte ending the run (four with NEON)
+        std::string mask = neon ?
+            "vget_lane_u64(vreinterpret_u64_u8("
+            "vshrn_n_u16(vreinterpretq_u16_u8(m), 4)), 0)" :
+            std::string("unsigned(") + p + "movemask_epi8(m))";
+        if (!run.negated) {
+            mask = neon ? "~" + mask :
+                x.width == 32 ? "~" + mask : mask + " ^ 0xffff";
+        }
+        os << "            unsigned long long stop = " << mask << ";\n"
+           << "            if (stop) {\n"
+           << "                return p + first_bit(stop)"
+           << (neon ? " / 4" : "") << ";\n"
+           << "            }\n"
+           << "            p += " << x.width << ";\n"
+           << "        }\n";
+    }
+    os << "#endif\n"
+       << "        return p;\n"
+       << "    }\n\n";
+}
+
+// %lex: scanner over a contiguous buffer, running the minimized DFA of the
+// rules on byte classes; a state is a label and its transitions a switch,
+// or with %table_driven, a row of the transition table
+void emit_lexer(
+    std::ostream&           os,
+    const GenerateOptions&  options,
+    const LexDfa&           dfa) {
+    std::vector<lex_run> runs;
+    std::vector<int> run_of = find_lex_runs(options, dfa, runs);
+
+    // what a match of a rule does: hand the token over, or scan on
+    auto emit_accept = [&](std::ostream& os, int rule, const char* indent) {
+        const LexRule& x = options.lex_rules[rule];
+        if (x.token.empty()) {
+            os << indent << "goto retry;\n";
+            return;
+        }
+        std::string token = options.token_prefix + x.token;
+        os << indent << "action_.lexeme(" << token << ", first, p_, v);\n"
+           << indent << "return " << token << ";\n";
+    };
+
+    stencil(
+        os, R"(
+// lexical analyzer of the %lex rules: next() returns the token of the
+// longest match (the first rule declared wins a tie) and passes the lexeme
+// to action.lexeme(token, first, last, value); skipped patterns are dropped
+template <class _Value, class _Action>
+class Lexer {
+public:
+    Lexer(_Action& action, const char* first, const char* last)
+        : action_(action), p_(first), last_(last), error_(false) {}
+
+    Token next(_Value& v) {
+$${tables}
+        const char* last = last_;
+        const char* first;
+        const char* p;
+        const char* end;
+        int rule;
+      retry:
+        if (p_ == last) { return ${eof}; }
+        first = p = end = p_;
+        rule = -1;
+$${states}
+        p_ = end;
+        switch (rule) {
+        case -1:
+            error_ = true;
+            return ${eof};
+$${cases}
+        default:
+            goto retry;
+        }
+    }
+
+    bool error() const { return error_; }
+    const char* position() const { return p_; }
+$${kernels}
+private:
+    _Action&    action_;
+    const char* p_;
+    const char* last_;
+    bool        error_;
+
+};
+
+)",
+        {"eof", options.token_prefix + "eof"},
+        {"kernels", [&](std::ostream& os) {
+                if (runs.empty()) { return; }
+                stencil(
+                    os, R"(
+
+private:
+#if CAPER_LEX_SIMD
+    static int first_bit(unsigned long long m) {
+#if defined(_MSC_VER)
+        unsigned long i;
+        if (_BitScanForward(&i, (unsigned long)m)) { return int(i); }
+        _BitScanForward(&i, (unsigned long)(m >> 32));
+        return int(i) + 32;
+#else
+        return __builtin_ctzll(m);
+#endif
+    }
+
+)"
+                    );
+                for (size_t k = 0 ; k < runs.size() ; k++) {
+                    emit_lex_kernel(os, int(k), runs[k]);
+                }
+                os << "#endif\n\n";
+            }},
+        {"tables", [&](std::ostream& os) {
+                out_of_line local;
+                emit_table(os, local, "byte_class", dfa.byte_class);
+                if (!options.table_driven) {
+                    return;
+                }
+                std::vector<int> transitions, accepts;
+                for (size_t s = 0 ; s < dfa.transitions.size() ; s++) {
+                    for (int t: dfa.transitions[s]) {
+                        transitions.push_back(t + 1);
+                    }
+                    accepts.push_back(dfa.accepts[s] + 1);
+                }
+                emit_table(os, local, "transitions", transitions);
+                emit_table(os, local, "accepts", accepts);
+            }},
+        {"cases", [&](std::ostream& os) {
+                // direct-coded final states accept by themselves
+                std::set<int> pending;
+                for (size_t s = 0 ; s < dfa.transitions.size() ; s++) {
+                    bool final = std::count(
+                        dfa.transitions[s].begin(), dfa.transitions[s].end(),
+                        -1) == dfa.class_count;
+                    if (options.table_driven || !final) {
+                        pending.insert(dfa.accepts[s]);
+                    }
+                }
+                for (size_t i = 0 ; i < options.lex_rules.size() ; i++) {
+                    if (options.lex_rules[i].token.empty() ||
+                        pending.count(int(i)) == 0) {
+                        continue;
+                    }
+                    os << "        case " << i << ":\n";
+                    emit_accept(os, int(i), "            ");
+                }
+            }},
+        {"states", [&](std::ostream& os) {
+                if (options.table_driven) {
+                    stencil(
+                        os, R"(
+        for (int state = 0 ; p != last ; ) {
+            state = transitions[
+                state * ${classes} + byte_class[(unsigned char)*p++]] - 1;
+            if (state < 0) { break; }
+            if (accepts[state]) {
+                rule = accepts[state] - 1;
+                end = p;
+            }
+        }
+)",
+                        {"classes", dfa.class_count}
+                        );
+                    return;
+                }
+
+                // direct-coded: the start state falls through, the others
+                // are entered by goto only
+                std::set<int> targets;
+                for (const auto& row: dfa.transitions) {
+                    for (int t: row) {
+                        if (0 <= t) { targets.insert(t); }
+                    }
+                }
+                for (size_t s = 0 ; s < dfa.transitions.size() ; s++) {
+                    if (0 <= run_of[s]) {
+                        // the kernel is entered by the loop only: a run
+                        // of one byte is not worth a call
+                        os << "      state_" << s << "_run:\n"
+                           << "#if CAPER_LEX_SIMD\n"
+                           << "        p = skip_" << run_of[s] << "(p, last);\n"
+                           << "#endif\n";
+                    }
+                    if (targets.count(int(s))) {
+                        os << "      state_" << s << ":\n";
+                    }
+                    std::map<int, std::vector<int>> cases;
+                    for (int c = 0 ; c < dfa.class_count ; c++) {
+                        int t = dfa.transitions[s][c];
+                        if (0 <= t) { cases[t].push_back(c); }
+                    }
+                    if (cases.empty()) {
+                        // no longer match from here: accept at once
+                        os << "        p_ = p;\n";
+                        emit_accept(os, dfa.accepts[s], "        ");
+                        continue;
+                    }
+                    if (0 <= dfa.accepts[s]) {
+                        os << "        rule = " << dfa.accepts[s] << ";\n"
+                           << "        end = p;\n";
+                    }
+                    if (s != 0) {
+                        // the start state is entered with some input left
+                        os << "        if (p == last) { goto done; }\n";
+                    }
+                    os << "        switch (byte_class[(unsigned char)*p++]) {\n";
+                    for (const auto& x: cases) {
+                        for (size_t i = 0 ; i < x.second.size() ; i++) {
+                            os << (i % 8 == 0 ? "        " : " ")
+                               << "case " << x.second[i] << ":"
+                               << (i % 8 == 7 ? "\n" : "");
+                        }
+                        os << (x.second.size() % 8 == 0 ? "           " : "")
+                           << " goto state_" << x.first
+                           << (x.first == int(s) && 0 <= run_of[s] ? "_run" : "")
+                           << ";\n";
+                    }
+                    os << "        default: goto done;\n"
+                       << "        }\n";
+                }
+                os << "      done:\n";
+            }}
+        );
+}
+
+void emit_parser_pool(std::ostream& os) {
+    stencil(
+        os, R"(
+// parsers kept for reuse: acquire() hands out a parser reset to the
+// semantic action, with the stack capacity of its earlier parses, and
+// release() takes it back. once the pool has grown to the number of
+// parsers in use at a time, neither allocates; a pool is not thread safe
+template <class _Parser>
+class ParserPool {
+public:
+    ParserPool() : count_(0) {}
+    ~ParserPool() {
+        for (size_t i = 0 ; i < free_.size() ; i++) {
+            delete free_[i];
+        }
+    }
+
+    template <class _SemanticAction>
+    _Parser* acquire(_SemanticAction& sa) {
+        if (free_.empty()) {
+            // room for it to come back, so that release() never grows
+            free_.reserve(++count_);
+            return new _Parser(sa);
+        }
+        _Parser* p = free_.back();
+        free_.pop_back();
+        p->reset(sa);
+        return p;
+    }
+
+    void release(_Parser* p) {
+        free_.push_back(p);
+    }
+
+    // makes n parsers up front, each with room for depth stack frames
+    template <class _SemanticAction>
+    void reserve(size_t n, size_t depth, _SemanticAction& sa) {
+        while (count_ < n) {
+            free_.reserve(++count_);
+            _Parser* p = new _Parser(sa);
+            p->reserve(depth);
+            free_.push_back(p);
+        }
+    }
+
+    size_t size() const { return count_; }
+
+private:
+    ParserPool(const ParserPool&);
+    void operator=(const ParserPool&);
+
+    std::vector<_Parser*>   free_;
+    size_t                  count_;
+
+};
+
+)");
+}
+
+// %arena: a bump allocator shared by the parser and the semantic action;
+// all it allocated goes away at once, destructors run in reverse order
+void emit_arena_class(std::ostream& os) {
+    stencil(
+        os, R"(
+class Arena {
+public:
+    template <class T>
+    struct Array {
+        T*      data;
+        size_t  size;
+
+        T* begin() const { return data; }
+        T* end() const { return data + size; }
+        T& operator[](size_t i) const { return data[i]; }
+    };
+
+public:
+    explicit Arena(size_t chunk_size = 64 * 1024)
+        : chunk_size_(chunk_size), used_(0), spare_(0),
+          top_(0), end_(0), finalizers_(0) {}
+    ~Arena() {
+        reset();
+        while (spare_) {
+            Chunk* c = spare_;
+            spare_ = c->next;
+            std::free(c);
+        }
+    }
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void* allocate(size_t size, size_t align = alignof(std::max_align_t)) {
+        char* p = align_up(top_, align);
+        if (!top_ || size_t(end_ - p) < size || end_ < p) {
+            grow(size + align);
+            p = align_up(top_, align);
+        }
+        top_ = p + size;
+        return p;
+    }
+
+    template <class T, class... Args>
+    T* make(Args&&... args) {
+        Finalizer* f = finalizer<T>();
+        T* p = new (allocate(sizeof(T), alignof(T)))
+            T(std::forward<Args>(args)...);
+        enlist(f, p, 1);
+        return p;
+    }
+
+    // copies the elements of an EBNF Sequence into one contiguous array
+    template <class S>
+    Array<typename S::const_iterator::value_type> collect(const S& s) {
+        typedef typename S::const_iterator::value_type T;
+        size_t n = 0;
+        for (typename S::const_iterator i = s.begin() ; i != s.end() ; ++i) {
+            n++;
+        }
+        Finalizer* f = finalizer<T>();
+        Array<T> a;
+        a.data = static_cast<T*>(allocate(sizeof(T) * n, alignof(T)));
+        a.size = 0;
+        for (typename S::const_iterator i = s.begin() ; i != s.end() ; ++i) {
+            new (&a.data[a.size]) T(*i);
+            enlist(f, a.data, ++a.size);
+        }
+        return a;
+    }
+
+    // destroys every object and keeps the chunks for reuse
+    void reset() {
+        for (Finalizer* f = finalizers_ ; f ; f = f->next) {
+            f->destroy(f->object, f->count);
+        }
+        finalizers_ = 0;
+        while (used_) {
+            Chunk* c = used_;
+            used_ = c->next;
+            c->next = spare_;
+            spare_ = c;
+        }
+        top_ = end_ = 0;
+    }
+
+private:
+    struct Chunk {
+        Chunk*  next;
+        size_t  size;
+    };
+
+    struct Finalizer {
+        void        (*destroy)(void*, size_t);
+        void*       object;
+        size_t      count;
+        Finalizer*  next;
+    };
+
+    static char* align_up(char* p, size_t align) {
+        return reinterpret_cast<char*>(
+            (reinterpret_cast<size_t>(p) + align - 1) & ~(align - 1));
+    }
+
+    void grow(size_t n) {
+        size_t size = sizeof(Chunk) + (n < chunk_size_ ? chunk_size_ : n);
+        Chunk** q = &spare_;
+        while (*q && (*q)->size < size) { q = &(*q)->next; }
+        Chunk* c = *q;
+        if (c) {
+            *q = c->next;
+        } else {
+            c = static_cast<Chunk*>(std::malloc(size));
+            if (!c) { throw std::bad_alloc(); }
+            c->size = size;
         }
+        c->next = used_;
+        used_ = c;
+        top_ = reinterpret_cast<char*>(c + 1);
+        end_ = reinterpret_cast<char*>(c) + c->size;
     }
-    return r;
+
+    template <class T>
+    static void destroy(void* p, size_t n) {
+        T* a = static_cast<T*>(p);
+        while (n) { a[--n].~T(); }
+    }
+
+    // trivially destructible objects need no finalizer
+    template <class T>
+    Finalizer* finalizer() {
+        if (std::is_trivially_destructible<T>::value) { return 0; }
+        Finalizer* f = static_cast<Finalizer*>(
+            allocate(sizeof(Finalizer), alignof(Finalizer)));
+        f->destroy = &destroy<T>;
+        f->object = 0;
+        f->count = 0;
+        f->next = 0;
+        return f;
+    }
+
+    // linked once the first object is constructed, so a throwing
+    // constructor leaves nothing to destroy
+    void enlist(Finalizer* f, void* p, size_t count) {
+        if (!f) { return; }
+        if (!f->object) {
+            f->object = p;
+            f->next = finalizers_;
+            finalizers_ = f;
+        }
+        f->count = count;
+    }
+
+private:
+    size_t      chunk_size_;
+    Chunk*      used_;
+    Chunk*      spare_;
+    char*       top_;
+    char*       end_;
+    Finalizer*  finalizers_;
+
+};
+
+)"
+        );
 }
 
-std::string normalize_sa_call(const std::string& s) {
-    std::string prefix;
-    for(auto c: s) {
-        if (c == '<' || c == '>') {
-            prefix = "template ";
-            break;
+// %typed_stack: a tagged union of every symbol type, so the stack holds
+// exact types and the semantic action needs no upcast/downcast
+void emit_value_class(
+    std::ostream&                       os,
+    const std::vector<std::string>&     value_types) {
+    auto each = [&](const char* s) {
+        return [&value_types, s](std::ostream& os) {
+            for (size_t i = 0 ; i < value_types.size() ; i++) {
+                stencil(os, s, {"i", i}, {"type", value_types[i]});
+            }
+        };
+    };
+
+    stencil(
+        os, R"(
+class Value {
+public:
+$${typedefs}
+
+    enum Tag {
+        tag_none,
+$${tags}
+    };
+
+public:
+    Value() : tag_(tag_none) {}
+$${constructors}
+    Value(const Value& x) : tag_(tag_none) { copy_from(x); }
+    Value(Value&& x) : tag_(tag_none) { move_from(x); }
+    ~Value() { clear(); }
+
+    Value& operator=(const Value& x) {
+        if (this != &x) { clear(); copy_from(x); }
+        return *this;
+    }
+    Value& operator=(Value&& x) {
+        if (this != &x) { clear(); move_from(x); }
+        return *this;
+    }
+
+    Tag tag() const { return tag_; }
+
+    template <class T> T& get();
+    template <class T> const T& get() const;
+
+private:
+    void clear() {
+        switch (tag_) {
+$${destroy}
+        default: break;
         }
+        tag_ = tag_none;
     }
-    return prefix + s;
+
+    void copy_from(const Value& x) {
+        switch (x.tag_) {
+$${copy}
+        default: break;
+        }
+        tag_ = x.tag_;
+    }
+
+    void move_from(Value& x) {
+        switch (x.tag_) {
+$${move}
+        default: break;
+        }
+        tag_ = x.tag_;
+    }
+
+private:
+    Tag tag_;
+    union {
+$${members}
+    };
+
+};
+
+$${getters}
+)",
+        {"typedefs", each(R"(
+    typedef ${type} type_${i};
+)")},
+        {"tags", each(R"(
+        tag_${i},
+)")},
+        {"constructors", each(R"(
+    Value(type_${i} x) : tag_(tag_${i}) { new (&v${i}_) type_${i}(move_value(x)); }
+)")},
+        {"destroy", each(R"(
+        case tag_${i}: v${i}_.~type_${i}(); break;
+)")},
+        {"copy", each(R"(
+        case tag_${i}: new (&v${i}_) type_${i}(x.v${i}_); break;
+)")},
+        {"move", each(R"(
+        case tag_${i}: new (&v${i}_) type_${i}(move_value(x.v${i}_)); break;
+)")},
+        {"members", each(R"(
+        type_${i} v${i}_;
+)")},
+        {"getters", each(R"(
+template <> inline Value::type_${i}& Value::get<Value::type_${i}>() {
+    assert(tag_ == tag_${i}); return v${i}_;
+}
+template <> inline const Value::type_${i}& Value::get<Value::type_${i}>() const {
+    assert(tag_ == tag_${i}); return v${i}_;
+}
+)")}
+        );
 }
 
 } // unnamed namespace
@@ -104,7 +3142,7 @@ void generate_cpp(
     const std::string&                  src_filename,
     std::ostream&                       os,
     const GenerateOptions&              options,
-    const std::map<std::string, Type>&,
+    const std::map<std::string, Type>&  terminal_types,
     const std::map<std::string, Type>&  nonterminal_types,
     const std::vector<std::string>&     tokens,
     const action_map_type&              actions,
@@ -128,6 +3166,72 @@ void generate_cpp(
         }
     }
 
+    // %typed_stack: distinct types of all symbols, in symbol order
+    std::vector<std::string> value_types;
+    if (options.typed_stack) {
+        std::set<std::string> known;
+        for (const auto* types: {&terminal_types, &nonterminal_types}) {
+            for (const auto& pair: *types) {
+                const Type& type = pair.second;
+                // skip untyped tokens, error token and EBNF nonterminals
+                if (type.name.empty() || type.name[0] == '$' ||
+                    type.extension != Extension::None) {
+                    continue;
+                }
+                std::string s = make_type_name(type, options.smart_pointer_tag);
+                if (known.insert(s).second) {
+                    value_types.push_back(s);
+                }
+            }
+        }
+    }
+
+    // compilers with rvalue references get the moving overloads
+    std::string cxx11 =
+        "__cplusplus >= 201103L || (defined(_MSC_VER) && 1600 <= _MSC_VER)";
+
+    // state dispatch: member function per state, one threaded function
+    // (%computed_goto), or the tables (%table_driven, which wins)
+    bool threaded = options.computed_goto && !options.table_driven;
+    std::string call_state =
+        options.table_driven ? "step" :
+        threaded ? "run" :
+        "(this->*(stack_top()->entry->state))";
+    // %recover_sync: garbage after a recovery is skipped, not recovered from
+    bool sync = options.recovery && options.recovery_sync;
+    auto call_gotof = [&](const std::string& frame) -> std::string {
+        return options.table_driven ?
+            "gotof(" + frame + "->entry, nonterminal)" :
+            "(this->*(" + frame + "->entry->gotof))(nonterminal)";
+    };
+
+    // %split_implementation: parser class name for out of line members
+    out_of_line ool;
+    ool.enabled = options.split_implementation && !options.glr;
+    ool.table_specifier =
+        options.constexpr_tables ? "constexpr" :
+        ool.enabled && options.table_driven ?
+        "extern const" :
+        "";
+    ool.template_head =
+        std::string("template <") +
+        (options.external_token ? "class _Token, " : "") +
+        (options.typed_stack ? "" : "class _Value, ") +
+        "class _SemanticAction, unsigned int _StackSize>";
+    ool.class_name =
+        std::string("Parser<") +
+        (options.external_token ? "_Token, " : "") +
+        (options.typed_stack ? "" : "_Value, ") +
+        "_SemanticAction, _StackSize>";
+
+    // %lex: the DFA, and whether its scanner uses SIMD kernels
+    LexDfa lex_dfa;
+    std::vector<lex_run> lex_runs;
+    if (!options.lex_rules.empty()) {
+        make_lex_dfa(options.lex_rules, lex_dfa);
+        find_lex_runs(options, lex_dfa, lex_runs);
+    }
+
     // once header / notice / URL / includes / namespace header
     stencil(
         os, R"(
@@ -136,21 +3240,95 @@ void generate_cpp(
 
 // This file was automatically generated by Caper.
 // (http://jonigata.github.io/caper/caper.html)
+$${split_notice}
 
 #include <cstdlib>
 #include <cassert>
 $${debug_include}
 $${use_stl}
+$${typed_stack}
+$${arena}
+$${profile}
+$${constexpr}
+$${parallel}
+$${lex}
 
 namespace ${namespace_name} {
 
 )",
         
         {"headername", headername},
+        {"split_notice", [&](std::ostream& os) {
+                if (ool.enabled) {
+                    stencil(
+                        os, R"(
+//
+// The parser members are defined at the end of this file, in a section
+// compiled only where ${headername}_IMPLEMENTATION is defined. Define it
+// in one translation unit, include this file and instantiate there the
+// parsers the program uses:
+//     template class ${namespace_name}::Parser<...>;
+)",
+                        {"headername", headername},
+                        {"namespace_name", options.namespace_name}
+                        );
+                }
+            }},
         {"debug_include",
             {options.debug_parser ? "#include <iostream>\n" : ""}},
         {"use_stl",
             {options.dont_use_stl ? "" : "#include <vector>\n"}},
+        {"typed_stack",
+            {options.typed_stack && !options.arena ? "#include <new>\n" : ""}},
+        {"arena",
+            {options.arena ?
+             "#include <cstddef>\n#include <new>\n#include <type_traits>\n"
+             "#include <utility>\n" : ""}},
+        {"constexpr",
+            {options.constexpr_tables ?
+             "#include <cstddef>\n"
+             "#if !(__cplusplus >= 201402L || "
+             "(defined(_MSVC_LANG) && 201402L <= _MSVC_LANG))\n"
+             "#error %constexpr requires C++14\n#endif\n" : ""}},
+        {"profile",
+            {options.profile ?
+             "#include <ostream>\n#if defined(CAPER_PROFILE_CLOCK)\n"
+             "#include <chrono>\n#endif\n" : ""}},
+        {"parallel",
+            {options.parallel_element.empty() ? "" :
+             "#if !(" + cxx11 + ")\n"
+             "#error %parallel requires C++11\n#endif\n"
+             "#include <thread>\n"}},
+        {"lex", [&](std::ostream& os) {
+                if (lex_runs.empty() || options.external_token) { return; }
+                stencil(
+                    os, R"(
+// %lex SIMD kernels: 0 scalar, 1 SSE2, 2 AVX2, 3 NEON
+#if !defined(CAPER_LEX_SIMD)
+#if defined(__AVX2__)
+#define CAPER_LEX_SIMD 2
+#elif defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && 2 <= _M_IX86_FP)
+#define CAPER_LEX_SIMD 1
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define CAPER_LEX_SIMD 3
+#else
+#define CAPER_LEX_SIMD 0
+#endif
+#endif
+#if CAPER_LEX_SIMD == 2
+#include <immintrin.h>
+#elif CAPER_LEX_SIMD == 1
+#include <emmintrin.h>
+#elif CAPER_LEX_SIMD == 3
+#include <arm_neon.h>
+#endif
+#if CAPER_LEX_SIMD && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+)"
+                    );
+            }},
         {"namespace_name", options.namespace_name}
         );
 
@@ -196,6 +3374,53 @@ $${labels}
 
     }
 
+    if (!options.lex_rules.empty()) {
+        if (options.external_token) {
+            os << "#error %lex does not support %external_token\n\n";
+        } else {
+            emit_lexer(os, options, lex_dfa);
+        }
+    }
+
+    // value passing: moved through the parser on C++11, copied before
+    stencil(
+        os, R"(
+#if ${cxx11}
+template <class T> struct move_traits {
+    typedef T&&         arg_type;
+    typedef T           take_type;
+};
+template <class T> T&& move_value(T& x) { return static_cast<T&&>(x); }
+#else
+template <class T> struct move_traits {
+    typedef const T&    arg_type;
+    typedef const T&    take_type;
+};
+template <class T> T& move_value(T& x) { return x; }
+$${typed_stack}
+$${arena}
+#endif
+
+)",
+        {"cxx11", cxx11},
+        {"typed_stack", {
+                options.typed_stack ?
+                "#error %typed_stack requires C++11\n" :
+                ""}},
+        {"arena", {
+                options.arena ?
+                "#error %arena requires C++11\n" :
+                ""}}
+        );
+
+    if (options.arena) {
+        emit_arena_class(os);
+    }
+
+    if (options.typed_stack) {
+        emit_value_class(os, value_types);
+    }
+
     // stack class header
     if (!options.dont_use_stl) {
         // STL version
@@ -206,125 +3431,169 @@ class Stack {
 public:
     Stack() { gap_ = 0; }
 
+    // frames below gap_ are untouched since the last commit; committed
+    // frames popped below it are saved in undo_ (top first)
     void rollback_tmp() {
+        if (gap_ == stack_.size() && undo_.empty()) { return; }
+        stack_.erase(stack_.begin()+ gap_, stack_.end());
+        for (size_t i = undo_.size() ; 0 < i ; i--) {
+            stack_.push_back(move_value(undo_[i - 1]));
+        }
+        undo_.clear();
         gap_ = stack_.size();
-        tmp_.clear();
     }
 
     void commit_tmp() {
-        // may throw
-        stack_.reserve(gap_ + tmp_.size());
-	   
-        // expect not to throw
-        stack_.erase(stack_.begin()+ gap_, stack_.end());
-        stack_.insert(stack_.end(), tmp_.begin(), tmp_.end());
-        tmp_.clear();
+        undo_.clear();
+        gap_ = stack_.size();
     }
-    bool push(const T& f) {
-        if (StackSize != 0 &&
-            int(StackSize) <= int(stack_.size() + tmp_.size())) {
+    bool push(typename move_traits<T>::arg_type f) {
+        if (StackSize != 0 && int(StackSize) <= int(stack_.size())) {
             return false;
         }
-        tmp_.push_back(f);
+        stack_.push_back(move_value(f));
         return true;
     }
 	   
     void pop(size_t n) {
-        if (tmp_.size() < n) {
-            n -= tmp_.size();
-            tmp_.clear();
-            gap_ -= n;
-        } else {
-            tmp_.erase(tmp_.end() - n, tmp_.end());
+        size_t d = stack_.size() - n;
+        while (d < gap_) {
+            undo_.push_back(move_value(stack_[--gap_]));
         }
+        stack_.erase(stack_.begin()+ d, stack_.end());
     }
 
     T& top() {
         assert(0 < depth());
-        if (!tmp_.empty()) {
-            return tmp_.back();
-        } else {
-            return stack_[gap_ - 1];
-        }
+        return stack_.back();
     }
 	   
     const T& get_arg(size_t base, size_t index) {
-        size_t n = tmp_.size();
-        if (base - index <= n) {
-            return tmp_[n - (base - index)];
-        } else {
-            return stack_[gap_ - (base - n) + index];
-        }
+        return stack_[stack_.size() - base + index];
+    }
+
+    bool is_tmp(size_t base, size_t index) const {
+        return gap_ <= stack_.size() - base + index;
     }
 	   
     void clear() {
         stack_.clear();
-        tmp_.clear();
+        undo_.clear();
         gap_ = 0; 
     }
 	   
     bool empty() const {
-        if (!tmp_.empty()) {
-            return false;
-        } else {
-            return gap_ == 0;
-        }
+        return stack_.empty();
     }
 	   
     size_t depth() const {
-        return gap_ + tmp_.size();
+        return stack_.size();
+    }
+
+    void reserve(size_t n) {
+        stack_.reserve(n);
+        undo_.reserve(n);
     }
 	   
     T& nth(size_t index) {
-        if (gap_ <= index) {
-            return tmp_[index - gap_];
-        } else {
-            return stack_[index];
-        }
+        return stack_[index];
     }
 
     void swap_top_and_second() {
         int d = depth();
         assert(2 <= d);
-        T x = nth(d - 1);
-        nth(d - 1) = nth(d - 2);
-        nth(d - 2) = x;
+        T x = move_value(nth(d - 1));
+        nth(d - 1) = move_value(nth(d - 2));
+        nth(d - 2) = move_value(x);
     }
 
 private:
     std::vector<T> stack_;
-    std::vector<T> tmp_;
+    std::vector<T> undo_;
     size_t gap_;
 	   
 };
 
 )");
     } else {
-        // bulkmemory version
+        // bulkmemory version: committed frames from the bottom, temporary
+        // ones from the top of one buffer
         stencil(
             os, R"(
+// %dont_use_stl: when set by Parser::set_stack_allocator(), the stack grows
+// through this instead of failing; it returns size bytes aligned for any
+// frame (0 to fail), or releases p when size is 0
+typedef void* (*stack_allocator)(void* context, void* p, size_t size);
+
 template <class T, unsigned int StackSize>
 class Stack {
 public:
-    Stack() { top_ = 0; gap_ = 0; tmp_ = 0; }
-    ~Stack() {}
+    Stack()
+        : base_(reinterpret_cast<T*>(&buffer_)), capacity_(StackSize),
+          allocator_(0), context_(0), owned_(false) {
+        top_ = 0; gap_ = 0; tmp_ = 0;
+    }
+    ~Stack() {
+        clear();
+        release();
+    }
+
+    // bytes a frame takes in a buffer of set_buffer()
+    static size_t frame_size() { return sizeof(T)${mark_size}; }
+
+    // frames move to size bytes at buffer, which must be aligned for T,
+    // or back to StackSize frames inside the stack for a null buffer
+    void set_buffer(void* buffer, size_t size) {
+        clear();
+        release();
+        if (buffer) {
+#if ${cxx11}
+            assert(size_t(buffer) % alignof(T) == 0);
+#endif
+            base_ = static_cast<T*>(buffer);
+            capacity_ = size / frame_size();
+        } else {
+            base_ = reinterpret_cast<T*>(&buffer_);
+            capacity_ = StackSize;
+        }
+    }
+
+    // memory of the allocator that is set is given back before it changes
+    void set_allocator(stack_allocator allocator, void* context) {
+        if (owned_) { set_buffer(0, 0); }
+        allocator_ = allocator;
+        context_ = context;
+    }
 
     void rollback_tmp() {
         for (size_t i = 0 ; i <tmp_ ; i++) {
-            at(StackSize - 1 - i).~T(); // explicit destructor
+            at(capacity_ - 1 - i).~T(); // explicit destructor
         }
         tmp_ = 0;
         gap_ = top_;
     }
 
     void commit_tmp() {
+        // temporary frame i goes from capacity_ - 1 - i to gap_ + i; near
+        // the end of the buffer the two ranges overlap, and frames found
+        // at both ends of a move are swapped instead
+        size_t low = capacity_ - tmp_;
         for (size_t i = 0 ; i <tmp_ ; i++) {
-            if (gap_ + i <top_) {
-                at(gap_ + i) = at(StackSize - 1 - i);
+            size_t d = gap_ + i;
+            size_t s = capacity_ - 1 - i;
+            if (s <= d) { break; }
+            if (low <= d) {
+                T x = move_value(at(d));
+                at(d) = move_value(at(s));
+                at(s) = move_value(x);
+                continue;
+            }
+            if (d <top_) {
+                at(d) = move_value(at(s));
             } else {
-                new (&at(gap_ + i)) T(at(StackSize - 1 - i));
+                new (&at(d)) T(move_value(at(s)));
             }
-            at(StackSize - 1 - i).~T(); // explicit destructor
+            at(s).~T(); // explicit destructor
         }
         if (gap_ + tmp_ <top_) {
             for (int i = 0 ; i <int(top_ - gap_ - tmp_); i++) {
@@ -336,9 +3605,9 @@ public:
         tmp_ = 0;
     }
 
-    bool push(const T& f) {
-        if (StackSize <= top_ + tmp_) { return false; }
-        new (&at(StackSize - 1 - tmp_++)) T(f);
+    bool push(typename move_traits<T>::arg_type f) {
+        if (capacity_ <= top_ + tmp_ && !grow()) { return false; }
+        new (&at(capacity_ - 1 - tmp_++)) T(move_value(f));
         return true;
     }
 
@@ -346,7 +3615,7 @@ public:
         size_t m = n; if (m > tmp_) { m = tmp_; }
 
         for (size_t i = 0 ; i <m ; i++) {
-            at(StackSize - tmp_ + i).~T(); // explicit destructor
+            at(capacity_ - tmp_ + i).~T(); // explicit destructor
         }
 
         tmp_ -= m;
@@ -356,7 +3625,7 @@ public:
     T& top() {
         assert(0 < depth());
         if (0 <tmp_) {
-            return at(StackSize - 1 -(tmp_-1));
+            return at(capacity_ - 1 -(tmp_-1));
         } else {
             return at(gap_ - 1);
         }
@@ -364,12 +3633,16 @@ public:
 
     const T& get_arg(size_t base, size_t index) {
         if (base - index <= tmp_) {
-            return at(StackSize-1 - (tmp_ -(base - index)));
+            return at(capacity_-1 - (tmp_ -(base - index)));
         } else {
             return at(gap_ -(base - tmp_) + index);
         }
     }
 
+    bool is_tmp(size_t base, size_t index) const {
+        return base - index <= tmp_;
+    }
+
     void clear() {
         rollback_tmp();
         for (size_t i = 0 ; i <top_ ; i++) {
@@ -386,57 +3659,233 @@ public:
         }
     }
 
-    size_t depth() const {
-        return gap_ + tmp_;
+    size_t depth() const {
+        return gap_ + tmp_;
+    }
+
+    size_t capacity() const {
+        return capacity_;
+    }
+
+    void reserve(size_t n) {
+        while (capacity_ < n && grow())
+            ;
+    }
+
+    T& nth(size_t index) {
+        if (gap_ <= index) {
+            return at(capacity_-1 - (index - gap_));
+        } else {
+            return at(index);
+        }
+    }
+
+    void swap_top_and_second() {
+        int d = depth();
+        assert(2 <= d);
+        T x = move_value(nth(d - 1));
+        nth(d - 1) = move_value(nth(d - 2));
+        nth(d - 2) = move_value(x);
+    }
+$${marks}
+private:
+    Stack(const Stack&);
+    void operator=(const Stack&);
+
+    T& at(size_t n) {
+        return base_[n];
+    }
+
+    bool grow() {
+        if (!allocator_) { return false; }
+        size_t n = capacity_ < 8 ? 16 : capacity_ * 2;
+        T* p = static_cast<T*>(allocator_(context_, 0, n * frame_size()));
+        if (!p) { return false; }
+        for (size_t i = 0 ; i <top_ ; i++) {
+            new (&p[i]) T(move_value(at(i)));
+            at(i).~T(); // explicit destructor
+        }
+        for (size_t i = 0 ; i <tmp_ ; i++) {
+            new (&p[n - 1 - i]) T(move_value(at(capacity_ - 1 - i)));
+            at(capacity_ - 1 - i).~T(); // explicit destructor
+        }
+$${move_marks}
+        release();
+        base_ = p;
+        capacity_ = n;
+        owned_ = true;
+        return true;
+    }
+
+    void release() {
+        if (owned_) {
+            allocator_(context_, base_, 0);
+            owned_ = false;
+        }
+    }
+
+private:
+#if ${cxx11}
+    alignas(T) char buffer_[${buffer_size}];
+#else
+    union {
+        char        bytes[${buffer_size}];
+        long double align_float;
+        void*       align_pointer;
+    } buffer_;
+#endif
+    T* base_;
+    size_t capacity_;
+    stack_allocator allocator_;
+    void* context_;
+    bool owned_;
+    size_t top_;
+    size_t gap_;
+    size_t tmp_;
+
+};
+
+)",
+            {"cxx11", cxx11},
+            {"mark_size", options.allow_ebnf ? " + sizeof(int)" : ""},
+            {"buffer_size", std::string(
+                    "(StackSize ? StackSize : 1) * (sizeof(T)") +
+                (options.allow_ebnf ? " + sizeof(int)" : "") + ")"},
+            {"marks", {
+                    options.allow_ebnf ?
+                    R"(
+    // an int for each frame of room, kept after the frames
+    int* marks() {
+        return reinterpret_cast<int*>(base_ + capacity_);
+    }
+)" : ""}},
+            {"move_marks", {
+                    options.allow_ebnf ?
+                    R"(        int* m = reinterpret_cast<int*>(p + n);
+        for (size_t i = 0 ; i <capacity_ ; i++) {
+            m[i] = marks()[i];
+        }
+)" : ""}}
+            );
+    }
+
+    // %table_driven / %constexpr tables
+    driver_tables tables;
+    if (options.table_driven || options.constexpr_tables || options.glr) {
+        make_driver_tables(options, nonterminal_types, tokens, table, tables);
+    }
+    if (options.constexpr_tables) {
+        emit_driver_table_definitions(os, "constexpr", tables);
+    }
+
+    // parser class footer
+    // namespace footer
+    // once footer
+    auto emit_footer = [&]() {
+        stencil(
+            os,
+            R"(
+$${parser_pool}
+$${constexpr_parser}
+} // namespace ${namespace_name}
+
+#endif // #ifndef ${headername}_
+
+)",
+            {"headername", {headername}},
+            {"namespace_name", {options.namespace_name}},
+            {"parser_pool", [&](std::ostream& os) {
+                    if (!options.dont_use_stl) {
+                        emit_parser_pool(os);
+                    }
+                }},
+            {"constexpr_parser", [&](std::ostream& os) {
+                    if (options.constexpr_tables) {
+                        emit_constexpr_parser(
+                            os, options, nonterminal_types, actions, table,
+                            tables);
+                    }
+                }}
+            );
+    };
+
+    if (options.glr) {
+        emit_glr_parser(
+            os, options, nonterminal_types, actions, table, tables, ool,
+            cxx11);
+        emit_footer();
+        return;
     }
 
-    T& nth(size_t index) {
-        if (gap_ <= index) {
-            return at(StackSize-1 - (index - gap_));
-        } else {
-            return at(index);
+    if (options.incremental) {
+        // frames are replaced by whole subtrees, kept in vectors
+        std::vector<std::string> unsupported;
+        if (options.dont_use_stl) {
+            unsupported.push_back("%dont_use_stl");
+        }
+        if (options.arena) {
+            unsupported.push_back("%arena");
+        }
+        for (const auto& pair: actions) {
+            if (pair.second.special) {
+                unsupported.push_back("EBNF rules");
+                break;
+            }
+        }
+        for (const auto& x: unsupported) {
+            os << "#error %incremental does not support " << x << "\n";
         }
     }
 
-    void swap_top_and_second() {
-        int d = depth();
-        assert(2 <= d);
-        T x = nth(d - 1);
-        nth(d - 1) = nth(d - 2);
-        nth(d - 2) = x;
-    }
-
-private:
-    T& at(size_t n) {
-        return *(T*)(stack_ + (n * sizeof(T)));
+    // %parallel: the path to the sequence is fixed by the grammar
+    std::vector<int> parallel_path;
+    int parallel_accumulator = 0;
+    if (!options.parallel_element.empty()) {
+        find_parallel_path(
+            options, nonterminal_types, table, parallel_path,
+            parallel_accumulator);
+
+        // chunks hand over a single accumulator each, and own their values
+        if (!options.streaming_sequence) {
+            os << "#error %parallel requires %streaming_sequence\n";
+        }
+        std::vector<std::string> unsupported;
+        if (options.dont_use_stl) {
+            unsupported.push_back("%dont_use_stl");
+        }
+        if (options.arena) {
+            unsupported.push_back("%arena");
+        }
+        if (options.incremental) {
+            unsupported.push_back("%incremental");
+        }
+        for (const auto& x: unsupported) {
+            os << "#error %parallel does not support " << x << "\n";
+        }
     }
 
-private:
-    char stack_[ StackSize * sizeof(T) ];
-    size_t top_;
-    size_t gap_;
-    size_t tmp_;
-
-};
-
-)"
-            );
+    // %recover_sync only narrows what the recovery of %recover does
+    if (options.recovery_sync && !options.recovery) {
+        os << "#error %recover_sync requires %recover\n";
     }
 
     // parser class header
     stencil(
         os, R"(
-template <${token_parameter}class _Value, class _SemanticAction,
+template <${token_parameter}${value_parameter}class _SemanticAction,
           unsigned int _StackSize = ${default_stack_size}>
 class Parser {
 public:
     typedef ${token_source} token_type;
-    typedef _Value value_type;
+    typedef ${value_source} value_type;
+    typedef typename move_traits<value_type>::arg_type value_arg_type;
 
     enum Nonterminal {
 )",
         {"token_parameter", options.external_token ? "class _Token, " : ""},
         {"token_source", options.external_token ? "_Token" : "Token"},
+        {"value_parameter", options.typed_stack ? "" : "class _Value, "},
+        {"value_source", options.typed_stack ? "Value" : "_Value"},
         {"default_stack_size", options.dont_use_stl ? "1024" : "0"}
         );
 
@@ -454,92 +3903,416 @@ public:
     };
 
 public:
-    Parser(_SemanticAction& sa) : sa_(sa) { reset(); }
-
+$${constructors}
     void reset() {
+$${reset_history}
         error_ = false;
         accepted_ = false;
         clear_stack();
+$${reset_arena}
         rollback_tmp_stack();
         if (push_stack(${first_state}, value_type())) {
             commit_tmp_stack();
         } else {
-            sa_.stack_overflow();
+            sa_->stack_overflow();
             error_ = true;
         }
     }
 
+#if ${cxx11}
     bool post(token_type token, const value_type& value) {
+        value_type v(value);
+        return post(token, move_value(v));
+    }
+
+#endif
+    bool post(token_type token, value_arg_type value) {
         rollback_tmp_stack();
         error_ = false;
-        while ((this->*(stack_top()->entry->state))(token, value))
+$${resync}
+        while (${call_state}(token, move_value(value)))
             ; // may throw
         if (!error_) {
             commit_tmp_stack();
         } else {
-            recover(token, value);
+            recover(token, move_value(value));
         }
+$${record_root}
         return accepted_ || error_;
     }
 
+    // posts tokens of [first, last) until accepted or a syntax error is
+    // left unrecovered; returns the iterator of the token that stopped
+    // the parse, or last
+    template <class Iterator, class TokenOf, class ValueOf>
+    Iterator post_range(Iterator first, Iterator last,
+                        TokenOf token_of, ValueOf value_of) {
+        for (; first != last ; ++first) {
+$${skip_range}
+            value_type value(value_of(*first));
+            if (post(token_of(*first), move_value(value))) {
+                break;
+            }
+        }
+        return first;
+    }
+
+    // pull mode: token = lexer.next(value) is read until accepted or a
+    // syntax error is left unrecovered; the lexer is a template parameter
+    // so its next can be inlined into the loop
+    template <class Lexer>
+    bool parse(Lexer& lexer, value_type& v) {
+        for (;;) {
+            value_type value;
+            token_type token = lexer.next(value);
+            if (post(token, move_value(value))) {
+                break;
+            }
+        }
+        return !error_ && accept(v);
+    }
+
     bool accept(value_type& v) {
         assert(accepted_);
         if (error_) { return false; }
-        v = accepted_value_;
+        v = move_value(accepted_value_);
         return true;
     }
 
     bool error() { return error_; }
 
+    // makes room for depth frames up front, so that parses staying below
+    // it never grow the stack
+    void reserve(size_t depth) { stack_.reserve(depth); }
+
 )",
-        {"first_state", table.first_state()}
+        {"first_state", table.first_state()},
+        {"call_state", call_state},
+        {"cxx11", cxx11},
+        {"constructors", {
+                options.arena ?
+                R"(    // the semantic action is handed the arena through set_arena()
+    Parser(_SemanticAction& sa) : sa_(&sa), arena_(&own_arena_) {
+        sa_->set_arena(*arena_);
+        reset();
+    }
+
+    // an arena passed in belongs to the caller; reset() leaves it alone
+    Parser(_SemanticAction& sa, Arena& arena) : sa_(&sa), arena_(&arena) {
+        sa_->set_arena(*arena_);
+        reset();
+    }
+
+    Arena& arena() { return *arena_; }
+
+    // rebinds the parser to another semantic action, which is handed the
+    // same arena
+    void reset(_SemanticAction& sa) {
+        sa_ = &sa;
+        sa_->set_arena(*arena_);
+        reset();
+    }
+
+)" :
+                R"(    Parser(_SemanticAction& sa) : sa_(&sa) { reset(); }
+
+    // rebinds the parser to another semantic action; the stack keeps its
+    // capacity, so a reused parser allocates nothing in itself
+    void reset(_SemanticAction& sa) {
+        sa_ = &sa;
+        reset();
+    }
+
+)"}},
+        {"reset_arena", {
+                options.arena ?
+                R"(        if (arena_ == &own_arena_) { own_arena_.reset(); }
+)" : ""}},
+        {"reset_history", {
+                std::string(
+                    options.incremental ?
+                    R"(        nodes_.clear();
+        kids_.clear();
+        root_ = -1;
+        pending_ = -1;
+        collected_ = 0;
+        recovered_ = false;
+)" : "") +
+                (sync ? "        syncing_ = false;\n" : "") +
+                (options.parallel_element.empty() ? "" :
+                 "        speculating_ = false;\n")}},
+        {"resync", {
+                sync ?
+                R"(        if (syncing_) {
+            if (skippable(token)) { return false; }
+            syncing_ = false;
+        }
+)" : ""}},
+        {"skip_range", {
+                // skipped tokens are not even converted to values
+                sync ?
+                R"(            if (syncing_ && skippable(token_of(*first))) {
+                continue;
+            }
+)" : ""}},
+        {"record_root", {
+                options.incremental ?
+                R"(        if (accepted_ && !error_) {
+            root_ = recovered_ ? -1 : stack_top()->node;
+        }
+)" : ""}}
+        );
+
+    stencil(
+        os, R"(
+$${stack_api}
+$${profile_api}
+$${incremental_api}
+$${parallel_api}
+)",
+        {"stack_api", {
+                options.dont_use_stl ?
+                R"(    // the stack starts in the _StackSize frames inside the parser;
+    // set_stack_buffer() moves it to size bytes of the caller, aligned for
+    // any frame, and set_stack_allocator() lets it grow when full instead
+    // of failing with stack_overflow(). both reset the parser. with
+    // _StackSize 0 the parser is small, but overflows until either is set
+    void set_stack_buffer(void* buffer, size_t size) {
+        stack_.set_buffer(buffer, size);
+        reset();
+    }
+
+    void set_stack_allocator(stack_allocator allocator, void* context) {
+        stack_.set_allocator(allocator, context);
+        reset();
+    }
+
+    // bytes a frame takes in a buffer of set_stack_buffer()
+    static size_t stack_frame_size() {
+        return Stack<stack_frame, _StackSize>::frame_size();
+    }
+
+)" : ""}},
+        {"profile_api", [&](std::ostream& os) {
+                if (!options.profile) {
+                    return;
+                }
+                stencil(
+                    os, R"(
+    // %profile: counters accumulated since construction or reset_profile();
+    // nanoseconds are measured only when CAPER_PROFILE_CLOCK is defined
+    struct Profile {
+        unsigned long       states[${state_count}];
+        unsigned long       reductions[${rule_count}];
+        unsigned long long  nanoseconds[${rule_count}];
+        unsigned long       shifts[${token_count}];
+        unsigned long       recoveries;
+        size_t              max_depth;
+
+        Profile() { clear(); }
+
+        void clear() {
+            for (int i = 0 ; i < ${state_count} ; i++) { states[i] = 0; }
+            for (int i = 0 ; i < ${rule_count} ; i++) {
+                reductions[i] = 0;
+                nanoseconds[i] = 0;
+            }
+            for (int i = 0 ; i < ${token_count} ; i++) { shifts[i] = 0; }
+            recoveries = 0;
+            max_depth = 0;
+        }
+    };
+
+    const Profile& profile() const { return profile_; }
+
+    void reset_profile() { profile_.clear(); }
+
+    // rules and tokens are named as in the grammar
+    void dump_profile(std::ostream& os) const {
+        static const char* const rule_labels[] = {
+$${rule_labels}
+        };
+        static const char* const token_labels[] = {
+$${token_labels}
+        };
+        os << "{\n  \"states\": [";
+        for (int i = 0 ; i < ${state_count} ; i++) {
+            os << (i ? ", " : "") << profile_.states[i];
+        }
+        os << "],\n  \"rules\": [\n";
+        for (int i = 0 ; i < ${rule_count} ; i++) {
+            os << "    {\"rule\": \"" << rule_labels[i]
+               << "\", \"reductions\": " << profile_.reductions[i]
+               << ", \"nanoseconds\": " << profile_.nanoseconds[i] << "}"
+               << (i + 1 < ${rule_count} ? ",\n" : "\n");
+        }
+        os << "  ],\n  \"shifts\": {";
+        for (int i = 0 ; i < ${token_count} ; i++) {
+            os << (i ? ", " : "") << "\"" << token_labels[i] << "\": "
+               << profile_.shifts[i];
+        }
+        os << "},\n  \"recoveries\": " << profile_.recoveries
+           << ",\n  \"max_depth\": " << profile_.max_depth << "\n}\n";
+    }
+
+)",
+                    {"state_count", table.states().size()},
+                    {"rule_count", table.get_grammar().size()},
+                    {"token_count", tokens.size()},
+                    {"rule_labels", [&](std::ostream& os) {
+                            for (const auto& rule: table.get_grammar()) {
+                                os << "            \"" << rule.left().name()
+                                   << " :";
+                                for (const auto& x: rule.right()) {
+                                    os << " " << (x.is_terminal() ?
+                                                  x.display() : x.name());
+                                }
+                                os << "\",\n";
+                            }
+                        }},
+                    {"token_labels", [&](std::ostream& os) {
+                            for (const auto& token: tokens) {
+                                os << "            \"" << token << "\",\n";
+                            }
+                        }}
+                    );
+            }},
+        {"incremental_api", [&](std::ostream& os) {
+                if (options.incremental) {
+                    emit_incremental_api(os, table);
+                }
+            }},
+        {"parallel_api", [&](std::ostream& os) {
+                if (!options.parallel_element.empty()) {
+                    emit_parallel_api(os, options);
+                }
+            }}
         );
 
     // implementation
     stencil(
         os, R"(
 private:
-    typedef Parser<${token_paremter}_Value, _SemanticAction, _StackSize> self_type;
-
-    typedef bool (self_type::*state_type)(token_type, const value_type&);
-    typedef int (self_type::*gotof_type)(Nonterminal);
+    typedef Parser<${token_paremter}${value_paremter}_SemanticAction, _StackSize> self_type;
 
+$${dispatch_types}
     bool            accepted_;
     bool            error_;
     value_type      accepted_value_;
-    _SemanticAction& sa_;
-
-    struct table_entry {
-        state_type  state;
-        gotof_type  gotof;
-        bool        handle_error;
-    };
+    _SemanticAction* sa_;
+$${arena_members}
+$${profile_members}
 
+$${table_entry}
     struct stack_frame {
         const table_entry*  entry;
         value_type          value;
         int                 sequence_length;
+$${frame_node}
 
-        stack_frame(const table_entry* e, const value_type& v, int sl)
-            : entry(e), value(v), sequence_length(sl) {}
+        stack_frame(const table_entry* e, value_arg_type v, int sl)
+            : entry(e), value(move_value(v)), sequence_length(sl)${node_init} {}
     };
 
+$${incremental_members}
+$${parallel_members}
 )",
-        {"token_paremter", options.external_token ? "_Token, " : ""}
+        {"token_paremter", options.external_token ? "_Token, " : ""},
+        {"value_paremter", options.typed_stack ? "" : "_Value, "},
+        {"frame_node", {
+                options.incremental ?
+                "        int                 node; // %incremental\n" : ""}},
+        {"node_init", {options.incremental ? ", node(-1)" : ""}},
+        {"incremental_members", [&](std::ostream& os) {
+                if (options.incremental) {
+                    emit_incremental_members(os, table);
+                }
+            }},
+        {"parallel_members", [&](std::ostream& os) {
+                if (!options.parallel_element.empty()) {
+                    emit_parallel_members(
+                        os, parallel_path, parallel_accumulator, call_state);
+                }
+            }},
+        {"profile_members", {
+                options.profile ?
+                R"(    Profile         profile_;
+#if defined(CAPER_PROFILE_CLOCK)
+    std::chrono::steady_clock::time_point profile_start_;
+#endif
+
+    bool profile_enter() {
+#if defined(CAPER_PROFILE_CLOCK)
+        profile_start_ = std::chrono::steady_clock::now();
+#endif
+        return true;
+    }
+
+    bool profile_reduce(int rule, bool result) {
+        profile_.reductions[rule]++;
+#if defined(CAPER_PROFILE_CLOCK)
+        profile_.nanoseconds[rule] +=
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - profile_start_).count();
+#endif
+        return result;
+    }
+)" : ""}},
+        {"arena_members", {
+                options.arena ?
+                R"(    Arena           own_arena_;
+    Arena*          arena_;
+)" : ""}},
+        {"dispatch_types", {
+                options.table_driven ? "" :
+                threaded ? R"(    typedef int (self_type::*gotof_type)(Nonterminal);
+
+)" :
+                R"(    typedef bool (self_type::*state_type)(token_type, value_arg_type);
+    typedef int (self_type::*gotof_type)(Nonterminal);
+
+)"}},
+        {"table_entry", {
+                options.table_driven ?
+                    R"(    struct table_entry {
+        int         no;
+        bool        handle_error;
+    };
+
+)" :
+                threaded ?
+                    R"(    struct table_entry {
+        int         no;
+        gotof_type  gotof;
+        bool        handle_error;
+    };
+
+)" :
+                    R"(    struct table_entry {
+        state_type  state;
+        gotof_type  gotof;
+        bool        handle_error;
+    };
+
+)"}}
         );
 
     // stack operation
     stencil(
         os, R"(
     Stack<stack_frame, _StackSize> stack_;
+$${symbol_starts}
 
-    bool push_stack(int state_index, const value_type& v, int sl = 0) {
-        bool f = stack_.push(stack_frame(entry(state_index), v, sl));
+    bool push_stack(int state_index, value_arg_type v, int sl = 0) {
+        bool f = stack_.push(stack_frame(entry(state_index), move_value(v), sl));
         assert(!error_);
         if (!f) { 
             error_ = true;
-            sa_.stack_overflow();
+            sa_->stack_overflow();
         }
+$${push_stack_symbol}
+$${push_stack_node}
+$${push_stack_profile}
         return f;
     }
 
@@ -551,32 +4324,157 @@ $${pop_stack_implementation}
         return &stack_.top();
     }
 
+    // the entry on the top once a reduction has popped base symbols
+    const table_entry* exposed_entry(int base) {
+$${exposed_entry}
+    }
+
     const value_type& get_arg(size_t base, size_t index) {
         return stack_.get_arg(base, index).value;
     }
 
+$${take_arg}
+
     void clear_stack() {
         stack_.clear();
+$${clear_symbols}
     }
 
     void rollback_tmp_stack() {
         stack_.rollback_tmp();
+$${rollback_symbols}
     }
 
     void commit_tmp_stack() {
         stack_.commit_tmp();
+$${commit_symbols}
+    }
+
+)",
+        {"symbol_starts", [&](std::ostream& os) {
+                if (!options.allow_ebnf) {
+                    return;
+                }
+                stencil(
+                    os, R"(
+    // EBNF: a symbol may span several frames (a sequence with its
+    // elements); ${starts}[k] is the first frame of the k-th symbol. The
+    // entries from touched_ up have been rewritten since the last commit
+$${starts_declaration}
+    int symbols_;
+    int touched_;
+
+    void set_symbol_start(int k, int s) {
+$${starts_grow}
+        ${starts}[k] = s;
+        if (k < touched_) { touched_ = k; }
+    }
+
+    void sync_top_symbol() {
+        // the top frame absorbs the symbols its sequence_length covers
+        int p = int(stack_.depth()) - 1;
+        int s = p - stack_.nth(p).sequence_length;
+        while (0 < symbols_ && s <= ${starts}[symbols_ - 1]) { symbols_--; }
+        set_symbol_start(symbols_++, s);
     }
 
+    void resync_symbols() {
+        // rollback_tmp restored the committed frames; entries below
+        // touched_ still describe them, so rebuild the rest from the top
+        int bottom = touched_ == 0 ? -1 : ${starts}[touched_ - 1];
+        int n = 0;
+        for (int p = int(stack_.depth()) - 1 ; 0 <= p ; n++) {
+            int s = p - stack_.nth(p).sequence_length;
+            if (s <= bottom) { break; }
+            p = s - 1;
+        }
+        symbols_ = touched_ + n;
+        int p = int(stack_.depth()) - 1;
+        for (int k = symbols_ - 1 ; touched_ <= k ; k--) {
+            ${starts}[k] = p - stack_.nth(p).sequence_length;
+            p = ${starts}[k] - 1;
+        }
+        touched_ = symbols_;
+    }
 )",
+                    {"starts", {
+                            options.dont_use_stl ?
+                            "stack_.marks()" : "starts_"}},
+                    {"starts_declaration", {
+                            options.dont_use_stl ? "" :
+                            "    std::vector<int> starts_;\n"}},
+                    {"starts_grow", {
+                            options.dont_use_stl ? "" :
+                            R"(        if (int(starts_.size()) <= k) { starts_.resize(k + 1); }
+)"}}
+                    );
+            }},
+        {"exposed_entry", {
+                options.allow_ebnf ?
+                "        return stack_nth_top(base)->entry;\n" :
+                "        return stack_.nth(stack_.depth() - 1 - base).entry;\n"}},
+        {"push_stack_profile", {
+                options.profile ?
+                R"(        if (profile_.max_depth < stack_.depth()) {
+            profile_.max_depth = stack_.depth();
+        }
+)" : ""}},
+        {"push_stack_symbol", {
+                options.allow_ebnf ?
+                R"(        if (f) { sync_top_symbol(); }
+)" : ""}},
+        {"push_stack_node", {
+                options.incremental ?
+                R"(        if (f) { record_node(state_index); }
+)" : ""}},
+        {"clear_symbols", {
+                options.allow_ebnf ?
+                R"(        symbols_ = touched_ = 0;
+)" : ""}},
+        {"rollback_symbols", {
+                std::string(
+                    options.allow_ebnf ?
+                    "        resync_symbols();\n" : "") +
+                (options.incremental ? "        pending_ = -1;\n" : "")}},
+        {"commit_symbols", {
+                options.allow_ebnf ?
+                R"(        touched_ = symbols_;
+)" : ""}},
+        {"take_arg", {
+                options.typed_stack ?
+                R"(    template <class T>
+    T take_arg(size_t base, size_t index) {
+        // frames pushed since the last commit are dropped on rollback,
+        // so only their values may be moved into a semantic action
+        value_type& v = stack_.nth(stack_.depth() - base + index).value;
+        if (stack_.is_tmp(base, index)) {
+            return move_value(v.template get<T>());
+        }
+        return v.template get<T>();
+    }
+)" :
+                R"(    typename move_traits<value_type>::take_type
+    take_arg(size_t base, size_t index) {
+        // frames pushed since the last commit are dropped on rollback,
+        // so only their values may be moved into a semantic action
+        value_type& v = stack_.nth(stack_.depth() - base + index).value;
+        if (stack_.is_tmp(base, index)) { return move_value(v); }
+        return v;
+    }
+)"}},
         {"pop_stack_implementation", [&](std::ostream& os) {
+                if (options.incremental) {
+                    os << "        note_children(n);\n";
+                }
                 if (options.allow_ebnf) {
                     stencil(
                         os, R"(
-        int nn = int(n);
-        while(nn--) {
-            stack_.pop(1 + stack_.top().sequence_length);
-        }
-)"
+        if (n == 0) { return; }
+        symbols_ -= int(n);
+        stack_.pop(stack_.depth() - ${starts}[symbols_]);
+)",
+                        {"starts", options.dont_use_stl ?
+                                "stack_.marks()" : "starts_"}
                         );
                 } else {
                     stencil(
@@ -591,7 +4489,8 @@ $${pop_stack_implementation}
     if (options.recovery) {
         stencil(
             os, R"(
-    void recover(token_type token, const value_type& value) {
+    void recover(token_type token, value_arg_type value) {
+$${note:recover}
         rollback_tmp_stack();
         error_ = false;
 $${debmes:start}
@@ -606,25 +4505,55 @@ $${debmes:failed}
 $${debmes:done}
         // post error_token;
 $${debmes:post_error_start}
-        while ((this->*(stack_top()->entry->state))(${recovery_token}, value_type()));
+        while (${call_state}(${recovery_token}, value_type()));
 $${debmes:post_error_done}
         commit_tmp_stack();
         // repost original token
         // if it still causes error, discard it;
 $${debmes:repost_start}
-        while ((this->*(stack_top()->entry->state))(token, value));
+        while (${call_state}(token, move_value(value)));
 $${debmes:repost_done}
+$${discard}
+    }
+
+)",
+            {"recovery_token", options.token_prefix + options.recovery_token},
+            {"call_state", call_state},
+            {"discard", [&](std::ostream& os) {
+                    stencil(
+                        os,
+                        sync ?
+                        R"(
+        if (!error_) {
+            commit_tmp_stack();
+        } else if (token != ${token_eof}) {
+            // the state recovery left on the top is kept for the tokens
+            // skipped until one it takes
+            rollback_tmp_stack();
+            syncing_ = true;
+        }
+        if (token != ${token_eof}) {
+            error_ = false;
+        }
+)" :
+                        R"(
         if (!error_) {
             commit_tmp_stack();
         }
         if (token != ${token_eof}) {
             error_ = false;
         }
-    }
-
 )",
-            {"recovery_token", options.token_prefix + options.recovery_token},
-            {"token_eof", options.token_prefix + "eof"},
+                        {"token_eof", options.token_prefix + "eof"}
+                        );
+                }},
+            {"note:recover", {
+                    std::string(
+                        options.profile ?
+                        "        profile_.recoveries++;\n" : "") +
+                    // %incremental: the tree no longer matches the tokens
+                    (options.incremental ?
+                     "        recovered_ = true;\n" : "")}},
             {"debmes:start", {
                     options.debug_parser ?
                         R"(        std::cerr << "recover rewinding start: stack depth = " << stack_.depth() << "\n";
@@ -661,56 +4590,160 @@ $${debmes:repost_done}
 )" :
                         ""}}
             );
+        if (sync) {
+            emit_recover_sync(os, options, tokens, table);
+        }
     } else {
         stencil(
             os, R"(
-    void recover(token_type, const value_type&) {
+    void recover(token_type, value_arg_type) {
+    }
+
+)"
+            );
+    }
+
+    if (options.allow_ebnf) {
+        stencil(
+            os, R"(
+    // EBNF support class
+    struct Range {
+        int beg;
+        int end;
+        Range() : beg(-1), end(-1) {}
+        Range(int b, int e) : beg(b), end(e) {}
+    };
+
+    template <class T>
+    class Optional {
+    public:
+        typedef Stack<stack_frame, _StackSize> stack_type;
+
+    public:
+        Optional(_SemanticAction& sa, stack_type& s, const Range& r)
+            : sa_(&sa), s_(&s), p_(r.beg == r.end ? -1 : r.beg){}
+
+        operator bool() const {
+            return 0 <= p_;
+        }
+        bool operator!() const {
+            return !bool(*this);
+        }
+        T operator*() const {
+$${downcast}
+        }
+
+    private:
+        _SemanticAction* sa_;
+        stack_type*     s_;
+        int             p_;
+
+    };
+
+$${sequence}
+    // EBNF support member functions
+    bool seq_head(Nonterminal nonterminal, int base) {
+        // case '*': base == 0
+        // case '+': base == 1
+        int dest = ${call_gotof:nth_top};
+        return push_stack(dest, value_type(), base);
+    }
+
+    bool seq_trail(Nonterminal, int base) {
+        // '*', '+' trailer
+        assert(base == 2);
+        stack_.swap_top_and_second();
+        stack_top()->sequence_length++;
+        sync_top_symbol();
+        return true;
+    }
+
+    bool seq_trail2(Nonterminal, int base) {
+        // '/' trailer
+        assert(base == 3);
+        stack_.swap_top_and_second();
+        pop_stack(1); // erase delimiter
+        stack_.swap_top_and_second();
+        stack_top()->sequence_length++;
+        sync_top_symbol();
+        return true;
+    }
+
+    bool opt_nothing(Nonterminal nonterminal, int base) {
+        // same as head of '*'
+        assert(base == 0);
+        return seq_head(nonterminal, base);
+    }
+
+    bool opt_just(Nonterminal nonterminal, int base) {
+        // same as head of '+'
+        assert(base == 1);
+        return seq_head(nonterminal, base);
+    }
+$${streaming}
+
+    Range seq_get_range(size_t base, size_t index) {
+        // returns beg = end if length = 0 (includes scalar value)
+        // distinguishing 0-length-vector against scalar value is
+        // caller's responsibility
+        int k = symbols_ - int(base - index);
+        assert(0 <= k && k < symbols_);
+        int next = k + 1 < symbols_ ? ${starts}[k + 1] : int(stack_.depth());
+        return Range(${starts}[k], next - 1);
     }
 
-)"
-            );
+    const value_type& seq_get_arg(size_t base, size_t index) {
+        Range r = seq_get_range(base, index);
+        // multiple value appearing here is not supported now
+        assert(r.end - r.beg == 0); 
+        return stack_.nth(r.beg).value;
     }
 
-    if (options.allow_ebnf) {
-        stencil(
-            os, R"(
-    // EBNF support class
-    struct Range {
-        int beg;
-        int end;
-        Range() : beg(-1), end(-1) {}
-        Range(int b, int e) : beg(b), end(e) {}
-    };
-
-    template <class T>
-    class Optional {
+    stack_frame* stack_nth_top(int n) {
+        // the state after a sequence is held by its head, the last frame
+        Range r = seq_get_range(n + 1, 0);
+        return &stack_.nth(r.end);
+    }
+)",
+            {"call_gotof:nth_top", call_gotof("stack_nth_top(base)")},
+            {"starts", options.dont_use_stl ? "stack_.marks()" : "starts_"},
+            {"downcast", {
+                    options.typed_stack ?
+                    R"(            return s_->nth(p_).value.template get<T>();
+)" :
+                    R"(            T v;
+            sa_->downcast(v, s_->nth(p_).value);
+            return v;
+)"}},
+            {"sequence", [&](std::ostream& os) {
+                    if (options.streaming_sequence) {
+                        stencil(
+                            os, R"(    template <class T>
+    class Sequence {
     public:
         typedef Stack<stack_frame, _StackSize> stack_type;
 
     public:
-        Optional(_SemanticAction& sa, stack_type& s, const Range& r)
-            : sa_(&sa), s_(&s), p_(r.beg == r.end ? -1 : r.beg){}
-
-        operator bool() const {
-            return 0 <= p_;
-        }
-        bool operator!() const {
-            return !bool(*this);
+        // the elements have already been passed to append() one by one;
+        // only the accumulator is left on the stack
+        Sequence(_SemanticAction&, stack_type& stack, const Range& r)
+            : accumulator_(stack.nth(r.beg).value) {
         }
-        T operator*() const {
-            T v;
-            sa_->downcast(v, s_->nth(p_).value);
-            return v;
+
+        const value_type& accumulator() const {
+            return accumulator_;
         }
 
     private:
-        _SemanticAction* sa_;
-        stack_type*     s_;
-        int             p_;
+        const value_type& accumulator_;
 
     };
 
-    template <class T>
+)"
+                            );
+                    } else {
+                        stencil(
+                            os, R"(    template <class T>
     class Sequence {
     public:
         typedef Stack<stack_frame, _StackSize> stack_type;
@@ -734,9 +4767,7 @@ $${debmes:repost_done}
                 return *this;
             }
             value_type operator*() const {
-                value_type v;
-                sa_->downcast(v, s_->nth(p_).value);
-                return v;
+$${downcast:iterator}
             }
             const_iterator& operator++() {
                 ++p_;
@@ -774,86 +4805,90 @@ $${debmes:repost_done}
 
     };
 
-    // EBNF support member functions
-    bool seq_head(Nonterminal nonterminal, int base) {
+)",
+                            {"downcast:iterator", {
+                                    options.typed_stack ?
+                                    R"(                return s_->nth(p_).value.template get<T>();
+)" :
+                                    R"(                value_type v;
+                sa_->downcast(v, s_->nth(p_).value);
+                return v;
+)"}}
+                            );
+                    }
+                }},
+            {"streaming", [&](std::ostream& os) {
+                    if (!options.streaming_sequence) {
+                        return;
+                    }
+                    stencil(
+                        os, R"(
+    // %streaming_sequence: an element is appended to the accumulator as
+    // soon as it is reduced, so a sequence occupies one stack frame
+    template <class T>
+    bool seq_head_stream(Nonterminal nonterminal, int base) {
         // case '*': base == 0
-        // case '+': base == 1
-        int dest = (this->*(stack_nth_top(base)->entry->gotof))(nonterminal);
-        return push_stack(dest, value_type(), base);
+        // case '+', '/': base == 1
+        value_type acc = value_type();
+        if (base == 1) {
+            seq_append<T>(acc, base);
+        }
+        pop_stack(base);
+        int dest = ${call_gotof};
+        return push_stack(dest, move_value(acc));
     }
 
-    bool seq_trail(Nonterminal, int base) {
+    template <class T>
+    bool seq_trail_stream(Nonterminal, int base) {
         // '*', '+' trailer
         assert(base == 2);
-        stack_.swap_top_and_second();
-        stack_top()->sequence_length++;
+        seq_append<T>(stack_.nth(stack_.depth() - base).value, base);
+        pop_stack(1);
         return true;
     }
 
-    bool seq_trail2(Nonterminal, int base) {
+    template <class T>
+    bool seq_trail2_stream(Nonterminal, int base) {
         // '/' trailer
         assert(base == 3);
-        stack_.swap_top_and_second();
-        pop_stack(1); // erase delimiter
-        stack_.swap_top_and_second();
-        stack_top()->sequence_length++;
+        seq_append<T>(stack_.nth(stack_.depth() - base).value, base);
+        pop_stack(2); // erase delimiter and element
         return true;
     }
 
-    bool opt_nothing(Nonterminal nonterminal, int base) {
-        // same as head of '*'
-        assert(base == 0);
-        return seq_head(nonterminal, base);
-    }
-
-    bool opt_just(Nonterminal nonterminal, int base) {
-        // same as head of '+'
-        assert(base == 1);
-        return seq_head(nonterminal, base);
-    }
-
-    Range seq_get_range(size_t base, size_t index) {
-        // returns beg = end if length = 0 (includes scalar value)
-        // distinguishing 0-length-vector against scalar value is
-        // caller's responsibility
-        int n = int(base - index);
-        assert(0 < n);
-        int prev_actual_index;
-        int actual_index  = stack_.depth();
-        while(n--) {
-            actual_index--;
-            prev_actual_index = actual_index;
-            actual_index -= stack_.nth(actual_index).sequence_length;
-        }
-        return Range(actual_index, prev_actual_index);
-    }
-
-    const value_type& seq_get_arg(size_t base, size_t index) {
-        Range r = seq_get_range(base, index);
-        // multiple value appearing here is not supported now
-        assert(r.end - r.beg == 0); 
-        return stack_.nth(r.beg).value;
-    }
-
-    stack_frame* stack_nth_top(int n) {
-        Range r = seq_get_range(n + 1, 0);
-        // multiple value appearing here is not supported now
-        assert(r.end - r.beg == 0);
-        return &stack_.nth(r.beg);
+    template <class T>
+    void seq_append(value_type& acc, int base) {
+        // the element is the last symbol of the rule
+$${take_element}
+        sa_->append(acc, move_value(x));
     }
-)"
+)",
+                        {"call_gotof", call_gotof("stack_top()")},
+                        {"take_element", {
+                                options.typed_stack ?
+                                R"(        T x(take_arg<T>(base, base - 1));
+)" :
+                                R"(        T x;
+        sa_->downcast(x, take_arg(base, base - 1));
+)"}}
+                        );
+                }}
             );
     }
 
     stencil(
         os, R"(
-    bool call_nothing(Nonterminal nonterminal, int base) {
+    // dest_index is the state the reduction goes to when the generator
+    // could tell it from the reducing state, or -1 to look it up in the
+    // gotof of the state the pop exposes
+    bool call_nothing(Nonterminal nonterminal, int base, int dest_index) {
         pop_stack(base);
-        int dest_index = (this->*(stack_top()->entry->gotof))(nonterminal);
+        if (dest_index < 0) { dest_index = ${call_gotof}; }
         return push_stack(dest_index, value_type());
     }
 
-)"
+)",
+        {"call_gotof", call_gotof("stack_top()")}
         );
 
     // member function signature -> index
@@ -897,21 +4932,20 @@ $${debmes:repost_done}
             stub_counts[sa.name] = stub_index+1;
 
             // header
-            stencil(
-                os, R"(
-    bool call_${stub_index}_${sa_name}(Nonterminal nonterminal, int base${args}) {
-)",
-                {"stub_index", stub_index},
-                {"sa_name", normalize_internal_sa_name(sa.name)},
-                {"args", [&](std::ostream& os) {
-                        for (size_t l = 0 ; l < sa.args.size() ; l++) {
-                            os << ", int arg_index" << l;
-                        }
-                    }}
-                );
+            std::stringstream declarator;
+            declarator << "call_" << stub_index << "_"
+                       << normalize_internal_sa_name(sa.name)
+                       << "(Nonterminal nonterminal, int base, int dest_index";
+            for (size_t l = 0 ; l < sa.args.size() ; l++) {
+                declarator << ", int arg_index" << l;
+            }
+            declarator << ")";
+            emit_member_declaration(os, ool, "bool", declarator.str());
+            std::ostream& def = ool.enabled ? ool.members : os;
+            def << member_head(ool, "bool", declarator.str());
 
             // check sequence conciousness
-            std::string get_arg = "get_arg";
+            std::string get_arg = "take_arg";
             for (const auto& arg: sa.args) {
                 if (arg.type.extension != Extension::None) {
                     get_arg = "seq_get_arg";
@@ -924,8 +4958,17 @@ $${debmes:repost_done}
                 const auto& arg = sa.args[l];
                 if (arg.type.extension == Extension::None) {
                     stencil(
-                        os, R"(
-        ${arg_type} arg${index}; sa_.downcast(arg${index}, ${get_arg}(base, arg_index${index}));
+                        def,
+                        !options.typed_stack ?
+                        R"(
+        ${arg_type} arg${index}; sa_->downcast(arg${index}, ${get_arg}(base, arg_index${index}));
+)" :
+                        get_arg == "take_arg" ?
+                        R"(
+        ${arg_type} arg${index}(take_arg<${arg_type}>(base, arg_index${index}));
+)" :
+                        R"(
+        ${arg_type} arg${index}(${get_arg}(base, arg_index${index}).template get<${arg_type}>());
 )",
                         {"arg_type", make_type_name(arg.type, options.smart_pointer_tag)},
                         {"get_arg", get_arg},
@@ -933,7 +4976,7 @@ $${debmes:repost_done}
                         );
                 } else {
                     stencil(
-                        os, R"(
+                        def, R"(
         ${arg_decl}; 
 )",
                         {"arg_decl", make_arg_decl(arg.type, l, options.smart_pointer_tag)}
@@ -943,15 +4986,20 @@ $${debmes:repost_done}
 
             // semantic action / automatic value conversion
             stencil(
-                os, R"(
-        ${nonterminal_type} r = sa_.${semantic_action_name}(${args});
-        value_type v; sa_.upcast(v, r);
+                def, R"(
+        ${nonterminal_type} r = sa_->${semantic_action_name}(${args});
+        ${upcast}
         pop_stack(base);
-        int dest_index = (this->*(stack_top()->entry->gotof))(nonterminal);
-        return push_stack(dest_index, v);
+        if (dest_index < 0) { dest_index = ${call_gotof}; }
+        return push_stack(dest_index, move_value(v));
     }
 
 )",
+                {"call_gotof", call_gotof("stack_top()")},
+                {"upcast", {
+                        options.typed_stack ?
+                        "value_type v(move_value(r));" :
+                        "value_type v; sa_->upcast(v, move_value(r));"}},
                 {"nonterminal_type", make_type_name(rule_type, options.smart_pointer_tag)},
                 {"semantic_action_name", normalize_sa_call(sa.name)},
                 {"args", [&](std::ostream& os) {
@@ -965,17 +5013,147 @@ $${debmes:repost_done}
                 );
         }
     }
+    if (ool.enabled) {
+        os << "\n";
+    }
 
-    // states handler
+    // reduce: return to post, or re-dispatch on the exposed state; a
+    // threaded parser jumps straight to the state the reduction goes to
+    // when that is a constant
+    auto emit_reduce = [&](
+        std::ostream& os, size_t rule_id, const std::string& reduce,
+        const std::string& dest) {
+        std::string call = options.profile ?
+            "(profile_enter() && profile_reduce(" + std::to_string(rule_id) +
+            ", " + reduce + "))" :
+            reduce;
+        bool constant =
+            dest.find_first_not_of("0123456789") == std::string::npos;
+        stencil(
+            os,
+            threaded ?
+            R"(
+            // reduce
+            if (!${call}) { return false; }
+            goto ${next};
+)" :
+            R"(
+            // reduce
+            return ${call};
+)",
+            {"call", call},
+            {"next", constant ? "state_" + dest : std::string("dispatch")}
+            );
+    };
+
+    // the state a reduction in a state goes to, as the stub argument: the
+    // states the pop can expose are found by walking the right side of the
+    // rule back from the reducing state. If they all go to one state on the
+    // left side, that is a constant; if a few go elsewhere, they are told
+    // apart by comparing the exposed entry; otherwise -1 leaves it to their
+    // gotof
+    std::vector<std::vector<std::pair<std::string, int>>> predecessors(
+        table.states().size());
     for (const auto& state: table.states()) {
+        for (const auto& pair: state.action_table) {
+            if (pair.second.type == zw::gr::action_shift) {
+                predecessors[pair.second.dest_index].push_back(
+                    std::make_pair(tokens[pair.first], state.no));
+            }
+        }
+        for (const auto& pair: state.goto_table) {
+            predecessors[pair.second].push_back(
+                std::make_pair(pair.first.name(), state.no));
+        }
+    }
+    const size_t max_goto_compares = 4;
+    auto static_goto = [&](
+        int state_no, const tgt::rule& rule) -> std::string {
+        std::set<int> exposed;
+        exposed.insert(state_no);
+        for (size_t i = rule.right().size() ; 0 < i ; i--) {
+            const auto& x = rule.right()[i - 1];
+            const std::string& name =
+                x.is_terminal() ? tokens[x.token()] : x.name();
+            std::set<int> next;
+            for (int q: exposed) {
+                for (const auto& e: predecessors[q]) {
+                    if (e.first == name) { next.insert(e.second); }
+                }
+            }
+            exposed.swap(next);
+        }
+
+        // exposed states by the state they go to
+        std::map<int, std::vector<int>> dests;
+        for (int p: exposed) {
+            int d = -1;
+            for (const auto& pair: table.states()[p].goto_table) {
+                if (pair.first.name() == rule.left().name()) {
+                    d = pair.second;
+                }
+            }
+            if (d < 0) { return "-1"; }
+            dests[d].push_back(p);
+        }
+        if (dests.empty()) { return "-1"; }
+
+        // the state most of them go to is the last alternative
+        auto common = dests.begin();
+        for (auto i = dests.begin() ; i != dests.end() ; ++i) {
+            if (common->second.size() < i->second.size()) { common = i; }
+        }
+        if (max_goto_compares < exposed.size() - common->second.size()) {
+            return "-1";
+        }
+        std::stringstream ss;
+        for (const auto& pair: dests) {
+            if (pair.first == common->first) { continue; }
+            for (int p: pair.second) {
+                ss << "exposed_entry(" << rule.right().size()
+                   << ") == entry(" << p << ") ? " << pair.first << " : ";
+            }
+        }
+        ss << common->first;
+        return ss.str();
+    };
+
+    // states handler
+    // every state_N/gotof_N pair is rendered independently, so large
+    // tables are split into contiguous chunks rendered on worker threads
+    // and concatenated in state order (output is identical to serial)
+    auto emit_handler = [&](
+        std::ostream& os, const tgt::parsing_table::state& state) {
         // state header
         stencil(
-            os, R"(
-    bool state_${state_no}(token_type token, const value_type& value) {
+            os,
+            threaded ?
+            R"(
+    state_${state_no}:
+$${debmes:state}
+$${profile:state}
+        switch(token) {
+)" :
+            R"(
+$${head}
 $${debmes:state}
+$${profile:state}
         switch(token) {
 )",
             {"state_no", state.no},
+            {"head", member_head(
+                    ool, "bool",
+                    "state_" + std::to_string(state.no) +
+                    "(token_type token, value_arg_type value)")},
+            {"profile:state", [&](std::ostream& os) {
+                    if (options.profile) {
+                        stencil(
+                            os, R"(
+        profile_.states[${state_no}]++;
+)",
+                            {"state_no", state.no}
+                            );
+                    }}},
             {"debmes:state", [&](std::ostream& os){
                     if (options.debug_parser) {
                         stencil(
@@ -992,7 +5170,9 @@ $${debmes:state}
             std::vector<std::string>,
             std::string,
             size_t,
-            std::vector<int>>
+            std::vector<int>,
+            size_t,
+            std::string>
             reduce_action_cache_key_type;
         typedef 
             std::map<reduce_action_cache_key_type,
@@ -1017,16 +5197,27 @@ $${debmes:state}
                         os, R"(
         case ${case_tag}:
             // shift
-            push_stack(/*state*/ ${dest_index}, value);
+$${profile:shift}
+            push_stack(/*state*/ ${dest_index}, move_value(value));
             return false;
 )",
                         {"case_tag", case_tag},
-                        {"dest_index", action.dest_index}
+                        {"dest_index", action.dest_index},
+                        {"profile:shift", [&](std::ostream& os) {
+                                if (options.profile) {
+                                    stencil(
+                                        os, R"(
+            profile_.shifts[${token}]++;
+)",
+                                        {"token", token}
+                                        );
+                                }}}
                         );
                     break;
                 case zw::gr::action_reduce: {
                     size_t base = rule.right().size();
                     const std::string& rule_name = rule.left().name();
+                    std::string dest = static_goto(state.no, rule);
 
                     auto k = finder(actions, rule);
                     if (k && !(*k).special) {
@@ -1045,7 +5236,10 @@ $${debmes:state}
                                 signature,
                                 rule_name,
                                 base,
-                                sa.source_indices);
+                                sa.source_indices,
+                                // %profile counts each rule on its own
+                                options.profile ? rule.id() : 0,
+                                dest);
 
                         reduce_action_cache[key].push_back(case_tag);
                     } else {
@@ -1059,17 +5253,19 @@ $${debmes:state}
                         if (k) {
                             const auto& sa = *k;
                             assert(sa.special);
-                            funcname = sa.name;
+                            funcname = make_special_call_name(
+                                terminal_types, nonterminal_types, rule, sa,
+                                options);
                         }
-                        stencil(
-                            os, R"(
-            // reduce
-            return ${funcname}(Nonterminal_${nonterminal}, /*pop*/ ${base});
-)",
-                            {"funcname", funcname},
-                            {"nonterminal", rule.left().name()},
-                            {"base", base}
-                            );
+                        std::stringstream call;
+                        call << funcname << "(Nonterminal_"
+                             << rule.left().name() << ", /*pop*/ "
+                             << base;
+                        if (!k) {
+                            call << ", /*goto*/ " << dest;
+                        }
+                        call << ")";
+                        emit_reduce(os, rule.id(), call.str(), k ? "-1" : dest);
                     }
                 }
                     break;
@@ -1079,7 +5275,7 @@ $${debmes:state}
         case ${case_tag}:
             // accept
             accepted_ = true;
-            accepted_value_ = get_arg(1, 0);
+            accepted_value_ = move_value(stack_top()->value);
             return false;
 )",
                         {"case_tag", case_tag}
@@ -1089,11 +5285,12 @@ $${debmes:state}
                     stencil(
                         os, R"(
         case ${case_tag}:
-            sa_.syntax_error();
+            ${syntax_error}
             error_ = true;
             return false;
 )",
-                        {"case_tag", case_tag}
+                        {"case_tag", case_tag},
+                        {"syntax_error", report_syntax_error(options)}
                         );
                     break;
             }
@@ -1121,45 +5318,51 @@ $${debmes:state}
                     );
             }
 
-            int index = stub_indices[signature];
+            int index = *finder(stub_indices, signature);
 
-            stencil(
-                os, R"(
-            // reduce
-            return call_${index}_${sa_name}(Nonterminal_${nonterminal}, /*pop*/ ${base}${args});
-)",
-                {"index", index},
-                {"sa_name", normalize_internal_sa_name(signature[0])},
-                {"nonterminal", nonterminal_name},
-                {"base", base},
-                {"args", [&](std::ostream& os) {
-                        for(const auto& x: arg_indices) {
-                            os  << ", " << x;
-                        }
-                    }}
-                );
+            std::stringstream call;
+            call << "call_" << index << "_"
+                 << normalize_internal_sa_name(signature[0])
+                 << "(Nonterminal_" << nonterminal_name << ", /*pop*/ "
+                 << base << ", /*goto*/ " << key.get<5>();
+            for(const auto& x: arg_indices) {
+                call << ", " << x;
+            }
+            call << ")";
+            emit_reduce(os, key.get<4>(), call.str(), key.get<5>());
         }
 
         // dispatcher footer / state footer
         stencil(
-            os, R"(
+            os,
+            threaded ?
+            R"(
+        default:
+            ${syntax_error}
+            error_ = true;
+            return false;
+        }
+
+)" :
+            R"(
         default:
-            sa_.syntax_error();
+            ${syntax_error}
             error_ = true;
             return false;
         }
     }
 
-)"
+)",
+            {"syntax_error", report_syntax_error(options)}
             );
+    };
 
+    auto emit_gotof = [&](
+        std::ostream& os, const tgt::parsing_table::state& state) {
         // gotof header
-        stencil(
-            os, R"(
-    int gotof_${state_no}(Nonterminal nonterminal) {
-)",
-            {"state_no", state.no}
-            );
+        os << member_head(
+            ool, "int",
+            "gotof_" + std::to_string(state.no) + "(Nonterminal nonterminal)");
             
         // gotof dispatcher
         std::stringstream ss;
@@ -1202,26 +5405,130 @@ $${debmes:state}
 
 )"
             );
+    };
 
+    // declarations of the state members defined out of line
+    std::ostream& def = ool.enabled ? ool.members : os;
+    if (ool.enabled && !options.table_driven) {
+        if (threaded) {
+            emit_member_declaration(
+                os, ool, "bool", "run(token_type token, value_arg_type value)");
+        }
+        for (const auto& state: table.states()) {
+            std::string n = std::to_string(state.no);
+            if (!threaded) {
+                emit_member_declaration(
+                    os, ool, "bool",
+                    "state_" + n + "(token_type token, value_arg_type value)");
+            }
+            emit_member_declaration(
+                os, ool, "int", "gotof_" + n + "(Nonterminal nonterminal)");
+        }
+        os << "\n";
+    }
+
+    if (options.table_driven) {
+        emit_driver_tables(
+            os, options, terminal_types, nonterminal_types, tokens, actions,
+            table, tables, stub_indices, ool);
+    } else if (threaded) {
+        // every state is a label in one function; a reduce jumps to the
+        // label of the state it exposes instead of returning to post.
+        // GNU compilers dispatch through a label address table, others
+        // through a switch on the state number. dispatch is left unused
+        // when every reduce jumps to a constant state.
+        stencil(
+            def, R"(
+#if defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#pragma GCC diagnostic ignored "-Wunused-label"
+#endif
+$${head}
+#if defined(__GNUC__)
+        static void* const labels[] = {
+$${labels}
+        };
+#endif
+
+    dispatch:
+#if defined(__GNUC__)
+        goto *labels[stack_top()->entry->no];
+#else
+        switch (stack_top()->entry->no) {
+$${cases}
+        default: assert(0); return false;
+        }
+#endif
+
+)",
+            {"head", member_head(
+                    ool, "bool", "run(token_type token, value_arg_type value)")},
+            {"labels", [&](std::ostream& os) {
+                    for (const auto& state: table.states()) {
+                        os << "            &&state_" << state.no << ",\n";
+                    }
+                }},
+            {"cases", [&](std::ostream& os) {
+                    for (const auto& state: table.states()) {
+                        os << "        case " << state.no
+                           << ": goto state_" << state.no << ";\n";
+                    }
+                }}
+            );
+        emit_states(def, table, emit_handler);
+        stencil(
+            def, R"(
+    }
+#if defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
 
+)"
+            );
+        emit_states(def, table, emit_gotof);
+    } else {
+        emit_states(
+            def, table,
+            [&](std::ostream& os, const tgt::parsing_table::state& state) {
+                emit_handler(os, state);
+                emit_gotof(os, state);
+            });
     }
 
     // table
+    emit_member_declaration(os, ool, "const table_entry*", "entry(int n) const");
     stencil(
-        os, R"(
-    const table_entry* entry(int n) const {
-        static const table_entry entries[] = {
+        def, R"(
+$${head}
+        static ${specifier} table_entry entries[] = {
 $${entries}
         };
         return &entries[n];
     }
 
 )",
+        {"head", member_head(
+                ool,
+                ool.enabled ?
+                "const typename " + ool.class_name + "::table_entry*" :
+                "const table_entry*",
+                "entry(int n) const")},
+        {"specifier", options.constexpr_tables ? "constexpr" : "const"},
         {"entries", [&](std::ostream& os) {
                 int i = 0;
                 for (const auto& state: table.states()) {
                     stencil(
-                        os, R"(
+                        os,
+                        options.table_driven ?
+                        R"(
+            { ${i}, ${handle_error} },
+)" :
+                        threaded ?
+                        R"(
+            { ${i}, &Parser::gotof_${i}, ${handle_error} },
+)" :
+                        R"(
             { &Parser::state_${i}, &Parser::gotof_${i}, ${handle_error} },
 )",
                             
@@ -1233,20 +5540,42 @@ $${entries}
             }}
         );
 
-    // parser class footer
-    // namespace footer
-    // once footer
-    stencil(
-        os,
-        R"(
-};
+    os << "};\n\n";
+    emit_footer();
+
+    if (ool.enabled) {
+        // the members were rendered at class indentation
+        std::stringstream members;
+        std::istringstream lines(ool.members.str());
+        std::string line;
+        while (std::getline(lines, line)) {
+            members << (line.compare(0, 4, "    ") == 0 ?
+                        line.substr(4) : line) << "\n";
+        }
+
+        stencil(
+            os, R"(
+#if defined(${headername}_IMPLEMENTATION) && !defined(${headername}_IMPLEMENTATION_)
+#define ${headername}_IMPLEMENTATION_
 
+namespace ${namespace_name} {
+
+$${tables}
+$${members}
 } // namespace ${namespace_name}
 
-#endif // #ifndef ${headername}_
+#endif // #if defined(${headername}_IMPLEMENTATION)
 
 )",
-        {"headername", {headername}},
-        {"namespace_name", {options.namespace_name}}
-        );
+            {"headername", {headername}},
+            {"namespace_name", {options.namespace_name}},
+            {"tables", [&](std::ostream& os) {
+                    if (ool.table_specifier == "extern const") {
+                        emit_driver_table_definitions(
+                            os, ool.table_specifier, tables);
+                    }
+                }},
+            {"members", {members.str()}}
+            );
+    }
 }
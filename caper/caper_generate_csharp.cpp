@@ -28,6 +28,9 @@ void generate_csharp(
     if (options.allow_ebnf) {
         throw unsupported_feature("C#", "EBNF");
     }
+    if (!options.lex_rules.empty()) {
+        throw unsupported_feature("C#", "%lex");
+    }
 
         os << "// This file was automatically generated by Caper.\n"
            << "// (http://jonigata.github.io/caper/caper.html)\n\n";
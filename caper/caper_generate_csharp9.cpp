@@ -4,6 +4,7 @@
 // $Id$
 
 #include "caper_ast.hpp"
+#include "caper_error.hpp"
 #include "caper_generate_cpp.hpp"
 #include "caper_format.hpp"
 #include "caper_stencil.hpp"
@@ -131,6 +132,10 @@ void generate_csharp9(
     const action_map_type&              actions,
     const tgt::parsing_table&           table) {
 
+    if (!options.lex_rules.empty()) {
+        throw unsupported_feature("C#", "%lex");
+    }
+
 #ifdef _WIN32
     char basename[_MAX_PATH];
     char extension[_MAX_PATH];
@@ -4,6 +4,7 @@
 // $Id$
 
 #include "caper_ast.hpp"
+#include "caper_error.hpp"
 #include "caper_generate_cpp.hpp"
 #include "caper_format.hpp"
 #include "caper_stencil.hpp"
@@ -61,6 +62,10 @@ void generate_d(
     const action_map_type&              actions,
     const tgt::parsing_table&           table) {
 
+    if (!options.lex_rules.empty()) {
+        throw unsupported_feature("D", "%lex");
+    }
+
     std::string module_name =
         boost::filesystem::path(src_filename).stem().string();
 
@@ -122,8 +127,9 @@ $${labels}
     }
 
     // stack
-    stencil(
-        os, R"(
+    if (!options.dont_use_stl) {
+        stencil(
+            os, R"(
 class Stack(T) {
 public:
     this() { _gap = 0; }
@@ -214,6 +220,138 @@ private:
 };
 
 )");
+    } else {
+        // one buffer version: committed frames from the bottom, temporary
+        // ones from the top
+        stencil(
+            os, R"(
+// %dont_use_stl: parsing allocates nothing while the frames fit in the
+// buffer; grow, when set, is asked for a longer one (of at least size
+// bytes, or null) instead of failing
+class Stack(T) {
+public:
+    alias void[] delegate(size_t size) Grow;
+
+    this(void[] buffer) { useBuffer(buffer); }
+
+    void useBuffer(void[] buffer) {
+        assert(cast(size_t) buffer.ptr % T.alignof == 0);
+        clear();
+        _buffer = cast(T[]) buffer[0 .. buffer.length / T.sizeof * T.sizeof];
+    }
+
+    void setGrow(Grow grow) { _grow = grow; }
+
+    void rollbackTmp() {
+        _tmp = 0;
+        _gap = _top;
+    }
+
+    void commitTmp() {
+        // temporary frame i goes from the end to _gap + i; near the end
+        // the two ranges overlap, and frames at both ends are swapped
+        uint n = capacity();
+        for (uint i = 0 ; i < _tmp ; i++) {
+            uint d = _gap + i;
+            uint s = n - 1 - i;
+            if (s <= d) { break; }
+            T x = _buffer[d];
+            _buffer[d] = _buffer[s];
+            _buffer[s] = x;
+        }
+        _top = _gap = _gap + _tmp;
+        _tmp = 0;
+    }
+
+    bool push(T f) {
+        if (capacity() <= _top + _tmp && !grow()) { return false; }
+        _buffer[capacity() - 1 - _tmp++] = f;
+        return true;
+    }
+	   
+    void pop(uint n) {
+        if (_tmp < n) {
+            _gap -= n - _tmp;
+            _tmp = 0;
+        } else {
+            _tmp -= n;
+        }
+    }
+
+    T* top() {
+        assert(0 < depth());
+        if (0 < _tmp) {
+            return &_buffer[capacity() - _tmp];
+        } else {
+            return &_buffer[_gap - 1];
+        }
+    }
+	   
+    T* getArg(uint base, uint index) {
+        if (base - index <= _tmp) {
+            return &_buffer[capacity() - 1 - (_tmp - (base - index))];
+        } else {
+            return &_buffer[_gap - (base - _tmp) + index];
+        }
+    }
+	   
+    void clear() {
+        _top = _gap = _tmp = 0;
+    }
+	   
+    bool empty() {
+        return depth() == 0;
+    }
+	   
+    uint depth() {
+        return _gap + _tmp;
+    }
+
+    uint capacity() {
+        return cast(uint) _buffer.length;
+    }
+	   
+    T* nth(uint index) {
+        if (_gap <= index) {
+            return &_buffer[capacity() - 1 - (index - _gap)];
+        } else {
+            return &_buffer[index];
+        }
+    }
+
+    void swapTopAndSecond() {
+        uint d = depth();
+        assert(2 <= d);
+        T x = *nth(d - 1);
+        *nth(d - 1) = *nth(d - 2);
+        *nth(d - 2) = x;
+    }
+
+private:
+    bool grow() {
+        if (_grow is null) { return false; }
+        uint n = capacity() < 8 ? 16 : capacity() * 2;
+        void[] memory = _grow(n * T.sizeof);
+        if (memory.length < n * T.sizeof) { return false; }
+        T[] b = cast(T[]) memory[0 .. memory.length / T.sizeof * T.sizeof];
+        b[0 .. _top] = _buffer[0 .. _top];
+        b[b.length - _tmp .. b.length] =
+            _buffer[capacity() - _tmp .. capacity()];
+        _buffer = b;
+        return true;
+    }
+
+private:
+    T[] _buffer;
+    Grow _grow;
+    uint _top;
+    uint _gap;
+    uint _tmp;
+	   
+};
+
+)");
+    }
 
     // parser class header
     stencil(
@@ -241,12 +379,11 @@ class Parser(Value, SemanticAction) {
         os, R"(
     }
 
-    this(SemanticAction sa){ _sa = sa; reset(); }
-
+$${constructor}
     void reset() {
         _error = false;
         _accepted = false;
-        _stack = new typeof(_stack);
+$${new_stack}
         clearStack();
         rollbackTmpStack();
         ValueType defaultValue;
@@ -279,8 +416,43 @@ class Parser(Value, SemanticAction) {
 
     bool error() { return _error; }
 
+$${stack_api}
 )",
-        {"first_state", table.first_state()}
+        {"first_state", table.first_state()},
+        {"constructor", {
+                options.dont_use_stl ?
+                R"(    this(SemanticAction sa) {
+        _sa = sa;
+        _stack = new typeof(_stack)(new StackFrame[1024]);
+        reset();
+    }
+
+)" :
+                R"(    this(SemanticAction sa){ _sa = sa; reset(); }
+
+)"}},
+        {"new_stack", {
+                options.dont_use_stl ? "" :
+                "        _stack = new typeof(_stack);\n"}},
+        {"stack_api", {
+                options.dont_use_stl ?
+                R"(    // the stack starts with 1024 frames; useStackBuffer() moves it to
+    // memory of the caller, and with setStackGrow() it grows when full
+    // instead of failing with stack_overflow(). both reset the parser
+    void useStackBuffer(void[] buffer) {
+        _stack.useBuffer(buffer);
+        reset();
+    }
+
+    void setStackGrow(void[] delegate(size_t size) grow) {
+        _stack.setGrow(grow);
+        reset();
+    }
+
+    // bytes a frame takes in a buffer of useStackBuffer()
+    static size_t stackFrameSize() { return StackFrame.sizeof; }
+
+)" : ""}}
         );
 
     // implementation
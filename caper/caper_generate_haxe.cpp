@@ -4,6 +4,7 @@
 // $Id$
 
 #include "caper_ast.hpp"
+#include "caper_error.hpp"
 #include "caper_generate_haxe.hpp"
 #include "caper_format.hpp"
 #include "caper_stencil.hpp"
@@ -103,6 +104,10 @@ void generate_haxe(
     const action_map_type&              actions,
     const tgt::parsing_table&           table) {
 
+    if (!options.lex_rules.empty()) {
+        throw unsupported_feature("Haxe", "%lex");
+    }
+
     // notice / URL / module / imports
     stencil(
         os, R"(
@@ -58,6 +58,9 @@ void generate_java(
     if (options.allow_ebnf) {
         throw unsupported_feature("Java", "EBNF");
     }
+    if (!options.lex_rules.empty()) {
+        throw unsupported_feature("Java", "%lex");
+    }
 
 	// once header
 	os << "// This file was automatically generated by Caper.\n"
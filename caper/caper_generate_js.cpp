@@ -4,6 +4,7 @@
 // $Id$
 
 #include "caper_ast.hpp"
+#include "caper_error.hpp"
 #include "caper_generate_cpp.hpp"
 #include "caper_format.hpp"
 #include "caper_stencil.hpp"
@@ -60,6 +61,10 @@ void generate_javascript(
     const action_map_type&              actions,
     const tgt::parsing_table&           table) {
 
+    if (!options.lex_rules.empty()) {
+        throw unsupported_feature("JavaScript", "%lex");
+    }
+
     // notice / URL
     stencil(
         os, R"(
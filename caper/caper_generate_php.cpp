@@ -64,6 +64,9 @@ void generate_php(
     if (options.allow_ebnf) {
         throw unsupported_feature("PHP", "EBNF");
     }
+    if (!options.lex_rules.empty()) {
+        throw unsupported_feature("PHP", "%lex");
+    }
 
     std::string namespace_name(options.namespace_name);
 
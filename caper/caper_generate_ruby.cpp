@@ -64,6 +64,9 @@ void generate_ruby(
     if (options.allow_ebnf) {
         throw unsupported_feature("Ruby", "EBNF");
     }
+    if (!options.lex_rules.empty()) {
+        throw unsupported_feature("Ruby", "%lex");
+    }
 
     std::string namespace_name(options.namespace_name);
     if ('a' <= namespace_name[0] && namespace_name[0] <= 'z')
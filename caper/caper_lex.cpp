@@ -0,0 +1,395 @@
+// %lex: regular expressions -> NFA (Thompson) -> DFA (subset construction)
+// -> minimized DFA (Moore), over classes of bytes
+
+#include "caper_lex.hpp"
+#include "caper_error.hpp"
+#include <algorithm>
+#include <bitset>
+#include <cctype>
+#include <map>
+
+namespace {
+
+typedef std::bitset<256> byte_set;
+
+struct nfa_state {
+    std::vector<std::pair<int, int>>    edges;      // (byte set, target)
+    std::vector<int>                    empties;
+    int                                 accept = -1;
+};
+
+struct nfa {
+    std::vector<nfa_state>      states;
+    std::vector<byte_set>       sets;       // distinct sets on the edges
+    std::map<std::string, int>  set_indices;
+
+    int add_state() {
+        states.push_back(nfa_state());
+        return int(states.size()) - 1;
+    }
+
+    void add_empty(int from, int to) {
+        states[from].empties.push_back(to);
+    }
+
+    void add_edge(int from, const byte_set& s, int to) {
+        auto i = set_indices.find(s.to_string());
+        if (i == set_indices.end()) {
+            i = set_indices.insert(
+                std::make_pair(s.to_string(), int(sets.size()))).first;
+            sets.push_back(s);
+        }
+        states[from].edges.push_back(std::make_pair((*i).second, to));
+    }
+};
+
+// the part of the NFA a subexpression became
+struct fragment {
+    int start;
+    int end;
+};
+
+// alternation  : sequence ('|' sequence)*
+// sequence     : repetition*
+// repetition   : atom ('*' | '+' | '?')*
+// atom         : '(' alternation ')' | '[' '^'? element+ ']' | '.'
+//              | '\' escape | byte
+class regex_parser {
+public:
+    regex_parser(nfa& n, const LexRule& rule)
+        : n_(n), rule_(rule), p_(rule.pattern), i_(0) {}
+
+    fragment parse() {
+        fragment f = alternation();
+        if (!at_end()) {
+            fail("unbalanced ')'");
+        }
+        return f;
+    }
+
+private:
+    bool at_end() const { return p_.size() <= i_; }
+    char peek() const { return p_[i_]; }
+    char next() { return p_[i_++]; }
+
+    void fail(const std::string& message) {
+        throw bad_regex(
+            rule_.addr, p_,
+            message + " at " + std::to_string(i_));
+    }
+
+    fragment alternation() {
+        fragment f = sequence();
+        while (!at_end() && peek() == '|') {
+            next();
+            fragment g = sequence();
+            fragment h { n_.add_state(), n_.add_state() };
+            n_.add_empty(h.start, f.start);
+            n_.add_empty(h.start, g.start);
+            n_.add_empty(f.end, h.end);
+            n_.add_empty(g.end, h.end);
+            f = h;
+        }
+        return f;
+    }
+
+    fragment sequence() {
+        int s = n_.add_state();
+        fragment f { s, s };
+        while (!at_end() && peek() != '|' && peek() != ')') {
+            fragment g = repetition();
+            n_.add_empty(f.end, g.start);
+            f.end = g.end;
+        }
+        return f;
+    }
+
+    fragment repetition() {
+        fragment f = atom();
+        while (!at_end() &&
+               (peek() == '*' || peek() == '+' || peek() == '?')) {
+            char c = next();
+            fragment h { n_.add_state(), n_.add_state() };
+            n_.add_empty(h.start, f.start);
+            n_.add_empty(f.end, h.end);
+            if (c != '+') { n_.add_empty(h.start, h.end); }
+            if (c != '?') { n_.add_empty(f.end, f.start); }
+            f = h;
+        }
+        return f;
+    }
+
+    fragment atom() {
+        char c = next();
+        byte_set s;
+        switch (c) {
+            case '(': {
+                fragment f = alternation();
+                if (at_end() || next() != ')') {
+                    fail("missing ')'");
+                }
+                return f;
+            }
+            case '*': case '+': case '?':
+                fail("nothing to repeat");
+                break;
+            case '[':
+                s = bracket();
+                break;
+            case '.':
+                s.set();
+                s.reset('\n');
+                break;
+            case '\\':
+                s = escape();
+                break;
+            default:
+                s.set((unsigned char)c);
+                break;
+        }
+        fragment f { n_.add_state(), n_.add_state() };
+        n_.add_edge(f.start, s, f.end);
+        return f;
+    }
+
+    byte_set escape() {
+        if (at_end()) {
+            fail("trailing '\\'");
+        }
+        char c = next();
+        byte_set s;
+        switch (c) {
+            case 'n': s.set('\n'); break;
+            case 'r': s.set('\r'); break;
+            case 't': s.set('\t'); break;
+            case 'f': s.set('\f'); break;
+            case 'v': s.set('\v'); break;
+            case '0': s.set(0); break;
+            case 'x': {
+                int n = 0;
+                for (int k = 0 ; k < 2 ; k++) {
+                    if (at_end() || !isxdigit((unsigned char)peek())) {
+                        fail("'\\x' needs two hex digits");
+                    }
+                    char d = next();
+                    n = n * 16 + (isdigit((unsigned char)d) ?
+                                  d - '0' : tolower(d) - 'a' + 10);
+                }
+                s.set(n);
+                break;
+            }
+            case 'd': case 'D':
+                for (int b = '0' ; b <= '9' ; b++) { s.set(b); }
+                break;
+            case 's': case 'S':
+                for (const char* p = " \t\n\r\f\v" ; *p ; p++) { s.set(*p); }
+                break;
+            case 'w': case 'W':
+                for (int b = 0 ; b < 256 ; b++) {
+                    if (b < 128 && (isalnum(b) || b == '_')) { s.set(b); }
+                }
+                break;
+            default:
+                s.set((unsigned char)c);
+                break;
+        }
+        if (c == 'D' || c == 'S' || c == 'W') {
+            s.flip();
+        }
+        return s;
+    }
+
+    byte_set element(int& single) {
+        // single is the byte when the element stands for one
+        byte_set s;
+        char c = next();
+        if (c == '\\') {
+            s = escape();
+        } else {
+            s.set((unsigned char)c);
+        }
+        single = -1;
+        if (s.count() == 1) {
+            for (int b = 0 ; b < 256 ; b++) {
+                if (s[b]) { single = b; }
+            }
+        }
+        return s;
+    }
+
+    byte_set bracket() {
+        bool negate = false;
+        if (!at_end() && peek() == '^') {
+            next();
+            negate = true;
+        }
+        byte_set s;
+        bool first = true;
+        for (;;) {
+            if (at_end()) {
+                fail("missing ']'");
+            }
+            if (peek() == ']' && !first) {
+                next();
+                break;
+            }
+            first = false;
+            int lo;
+            byte_set x = element(lo);
+            if (0 <= lo && i_ + 1 < p_.size() && peek() == '-' &&
+                p_[i_ + 1] != ']') {
+                next();
+                int hi;
+                element(hi);
+                if (hi < lo) {
+                    fail("bad range");
+                }
+                for (int b = lo ; b <= hi ; b++) { s.set(b); }
+            } else {
+                s |= x;
+            }
+        }
+        if (negate) {
+            s.flip();
+        }
+        if (s.none()) {
+            fail("empty class");
+        }
+        return s;
+    }
+
+private:
+    nfa&                n_;
+    const LexRule&      rule_;
+    const std::string&  p_;
+    size_t              i_;
+
+};
+
+void close_over_empties(const nfa& n, std::vector<int>& x) {
+    std::vector<bool> in(n.states.size());
+    std::vector<int> work(x);
+    for (int s: x) { in[s] = true; }
+    while (!work.empty()) {
+        int s = work.back();
+        work.pop_back();
+        for (int t: n.states[s].empties) {
+            if (!in[t]) {
+                in[t] = true;
+                x.push_back(t);
+                work.push_back(t);
+            }
+        }
+    }
+    std::sort(x.begin(), x.end());
+}
+
+} // unnamed namespace
+
+void make_lex_dfa(const std::vector<LexRule>& rules, LexDfa& dfa) {
+    // one NFA for all rules, tried in parallel from a common start
+    nfa n;
+    int start = n.add_state();
+    for (size_t i = 0 ; i < rules.size() ; i++) {
+        fragment f = regex_parser(n, rules[i]).parse();
+        n.add_empty(start, f.start);
+        n.states[f.end].accept = int(i);
+    }
+
+    // byte classes: bytes are split by every set on the edges
+    dfa.byte_class.assign(256, 0);
+    dfa.class_count = 1;
+    for (const auto& s: n.sets) {
+        std::map<std::pair<int, bool>, int> split;
+        for (int b = 0 ; b < 256 ; b++) {
+            auto key = std::make_pair(dfa.byte_class[b], bool(s[b]));
+            auto i = split.insert(std::make_pair(key, int(split.size())));
+            dfa.byte_class[b] = (*i.first).second;
+        }
+        dfa.class_count = int(split.size());
+    }
+    std::vector<int> representative(dfa.class_count);
+    for (int b = 255 ; 0 <= b ; b--) {
+        representative[dfa.byte_class[b]] = b;
+    }
+
+    // subset construction
+    std::vector<std::vector<int>> subsets;
+    std::map<std::vector<int>, int> subset_indices;
+    std::vector<std::vector<int>> transitions;
+    std::vector<int> accepts;
+    subsets.push_back(std::vector<int>(1, start));
+    close_over_empties(n, subsets[0]);
+    subset_indices[subsets[0]] = 0;
+    for (size_t k = 0 ; k < subsets.size() ; k++) {
+        int accept = -1;
+        for (int s: subsets[k]) {
+            int a = n.states[s].accept;
+            if (0 <= a && (accept < 0 || a < accept)) { accept = a; }
+        }
+        accepts.push_back(accept);
+
+        std::vector<int> row(dfa.class_count, -1);
+        for (int c = 0 ; c < dfa.class_count ; c++) {
+            std::vector<int> x;
+            for (int s: subsets[k]) {
+                for (const auto& edge: n.states[s].edges) {
+                    if (n.sets[edge.first][representative[c]]) {
+                        x.push_back(edge.second);
+                    }
+                }
+            }
+            if (x.empty()) { continue; }
+            close_over_empties(n, x);
+            x.erase(std::unique(x.begin(), x.end()), x.end());
+            auto i = subset_indices.find(x);
+            if (i == subset_indices.end()) {
+                i = subset_indices.insert(
+                    std::make_pair(x, int(subsets.size()))).first;
+                subsets.push_back(x);
+            }
+            row[c] = (*i).second;
+        }
+        transitions.push_back(row);
+    }
+
+    if (0 <= accepts[0]) {
+        const LexRule& rule = rules[accepts[0]];
+        throw bad_regex(rule.addr, rule.pattern, "matches the empty string");
+    }
+
+    // minimization: states stay together while they accept the same rule
+    // and move to the same blocks; blocks are numbered in state order, so
+    // the start state stays 0
+    size_t m = transitions.size();
+    std::vector<int> block(m);
+    int count = 0;
+    for (;;) {
+        std::map<std::vector<int>, int> signatures;
+        std::vector<int> next(m);
+        for (size_t s = 0 ; s < m ; s++) {
+            std::vector<int> signature;
+            signature.push_back(count == 0 ? accepts[s] : block[s]);
+            for (int t: transitions[s]) {
+                signature.push_back(t < 0 ? -1 : block[t]);
+            }
+            auto i = signatures.insert(
+                std::make_pair(signature, int(signatures.size())));
+            next[s] = (*i.first).second;
+        }
+        bool stable = int(signatures.size()) == count;
+        block.swap(next);
+        count = int(signatures.size());
+        if (stable) { break; }
+    }
+
+    dfa.transitions.assign(count, std::vector<int>(dfa.class_count, -1));
+    dfa.accepts.assign(count, -1);
+    for (size_t s = 0 ; s < m ; s++) {
+        dfa.accepts[block[s]] = accepts[s];
+        for (int c = 0 ; c < dfa.class_count ; c++) {
+            int t = transitions[s][c];
+            dfa.transitions[block[s]][c] = t < 0 ? -1 : block[t];
+        }
+    }
+}
@@ -0,0 +1,22 @@
+#ifndef CAPER_LEX_HPP
+#define CAPER_LEX_HPP
+
+#include "caper_ast.hpp"
+
+////////////////////////////////////////////////////////////////
+// LexDfa
+//   the minimized DFA of the %lex rules. bytes no rule tells apart share
+//   a class; state 0 is the start, and a state accepting several rules
+//   accepts the first one declared
+struct LexDfa {
+    std::vector<int>                byte_class;     // [256]
+    int                             class_count = 0;
+    std::vector<std::vector<int>>   transitions;    // [state][class], -1
+    std::vector<int>                accepts;        // [state], rule or -1
+};
+
+////////////////////////////////////////////////////////////////
+// make_lex_dfa
+void make_lex_dfa(const std::vector<LexRule>& rules, LexDfa& dfa);
+
+#endif // CAPER_LEX_HPP
@@ -26,6 +26,19 @@ public:
         dirdic_["dont_use_stl"] = token_directive_dont_use_stl;
         dirdic_["value_type"] = token_directive_value_type;
         dirdic_["smart_pointer"] = token_directive_smart_pointer;
+        dirdic_["table_driven"] = token_directive_table_driven;
+        dirdic_["computed_goto"] = token_directive_computed_goto;
+        dirdic_["typed_stack"] = token_directive_typed_stack;
+        dirdic_["streaming_sequence"] = token_directive_streaming_sequence;
+        dirdic_["arena"] = token_directive_arena;
+        dirdic_["profile"] = token_directive_profile;
+        dirdic_["split_implementation"] = token_directive_split_implementation;
+        dirdic_["constexpr"] = token_directive_constexpr;
+        dirdic_["glr"] = token_directive_glr;
+        dirdic_["incremental"] = token_directive_incremental;
+        dirdic_["lex"] = token_directive_lex;
+        dirdic_["parallel"] = token_directive_parallel;
+        dirdic_["recover_sync"] = token_directive_recover_sync;
         lines_.push_back(0);
     }
     ~scanner() {}
@@ -173,6 +186,26 @@ public:
             return token_typetag;
         }
 
+        // 
+        if (c == '"') {
+            std::stringstream ss;
+            for (c = sgetc(); c != '"'; c = sgetc()) {
+                if (c == eof || c == '\n') {
+                    throw unexpected_char(addr_, c);
+                }
+                ss << char(c);
+                if (c == '\\') {
+                    c = sgetc();
+                    if (c == eof || c == '\n') {
+                        throw unexpected_char(addr_, c);
+                    }
+                    ss << char(c);
+                }
+            }
+            v = value(b, Literal(ss.str()));
+            return token_string;
+        }
+
         throw unexpected_char(addr_, c);
     }
 
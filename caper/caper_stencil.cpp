@@ -1,52 +1,124 @@
 // 2014/03/21 Naoyuki Hirayama
 
 #include <iostream>
-#include <sstream>
 #include <cassert>
+#include <cstring>
 #include <exception>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
 #include "caper_stencil.hpp"
 #include "caper_format.hpp"
 
+namespace {
+
+// name == nullptr Ȃ烊e [text, text + length)
+// łȂ΃Xbg ${name}
+struct StencilSegment {
+    const char* text;
+    size_t      length;
+    const char* name;
+    size_t      name_length;
+    size_t      binding;    // Ovbinding̈ʒu(qg)
+};
+
+typedef std::vector<StencilSegment> CompiledStencil;
+
+void compile_stencil(const char* t, CompiledStencil& segments) {
+    const char* p = t;
+    if (*p == '\n') {
+        p++;
+    }
+
+    const char* literal = p;
+    auto flush = [&](const char* q) {
+        if (literal < q) {
+            segments.push_back({ literal, size_t(q - literal), nullptr, 0, 0 });
+        }
+    };
+
+    while (*p) {
+        if (*p != '$') {
+            p++;
+            continue;
+        }
+
+        flush(p);
+        p++;
+        bool chomp = false;
+        if (*p == '$') {
+            chomp = true;
+            p++;
+        }
+        if (*p != '{') {
+            throw std::runtime_error(
+                format("stencil: unexpected char: %c", *p));
+        }
+        const char* name = ++p;
+        while (*p && *p != '}') {
+            p++;
+        }
+        if (!*p) {
+            throw std::runtime_error(
+                "stencil: unterminated template parameter: " +
+                std::string(name, p));
+        }
+        segments.push_back({ nullptr, 0, name, size_t(p - name), 0 });
+        p++;
+        if (chomp && *p) {
+            p++;
+        }
+        literal = p;
+    }
+    flush(p);
+}
+
+bool match_binding(const StencilSegment& s, const StencilBinding* b) {
+    return
+        std::strncmp(b->name, s.name, s.name_length) == 0 &&
+        b->name[s.name_length] == '\0';
+}
+
+} // namespace
+
 void stencil_output(
     std::ostream& os,
     const char* t,
-    const std::map<std::string, StencilCallback>& m) {
+    const StencilBinding* const* bindings,
+    size_t binding_count) {
+
+    // ev[g̓eȂ̂ŃAhXœł
+    // (ob`[hł͕XbhĂ΂̂ŃXbh)
+    thread_local std::unordered_map<const char*, CompiledStencil> cache;
 
-    std::stringstream ss(t);
-    int c = ss.get();
-    if (c != '\n') {
-        ss.unget();
+    auto i = cache.find(t);
+    if (i == cache.end()) {
+        CompiledStencil segments;
+        compile_stencil(t, segments);
+        i = cache.emplace(t, std::move(segments)).first;
     }
-    
-    while((c = ss.get()) != std::char_traits<char>::eof()) {
-        if (c == '$') {
-            bool chomp = false;
-            c = ss.get();
-            if (c == '$') {
-                chomp = true;
-                c = ss.get();
-            }
-            if (c != '{') {
-                throw std::runtime_error(
-                    format("stencil: unexpected char: %c", char(c)));
-            }
-            assert(c == '{');
-            std::stringstream k;
-            while ((c = ss.get()) != '}') {
-                k << char(c);
+
+    for (auto& s: (*i).second) {
+        if (!s.name) {
+            os.write(s.text, s.length);
+            continue;
+        }
+
+        // ĂяoӏƂbinding̕т͓Ȃ̂ŁAʏ̓qgňv
+        if (binding_count <= s.binding ||
+            !match_binding(s, bindings[s.binding])) {
+            size_t j = 0;
+            while (j < binding_count && !match_binding(s, bindings[j])) {
+                j++;
             }
-            auto f = m.find(k.str());
-            if (f == m.end()) {
+            if (j == binding_count) {
                 throw std::runtime_error(
-                    "undefined template parameter: " + k.str());
-            }
-            (*f).second(os);
-            if (chomp) {
-                ss.get();
+                    "undefined template parameter: " +
+                    std::string(s.name, s.name_length));
             }
-        } else {
-            os << char(c);
+            s.binding = j;
         }
+        bindings[s.binding]->callback(os);
     }
 }
 
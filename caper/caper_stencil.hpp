@@ -11,79 +11,99 @@
 #define CAPER_STENCIL_HPP_
 
 #include <iostream>
-#include <functional>
 #include <string>
-#include <map>
+#include <cstddef>
 
 class StencilCallback {
 public:
-    StencilCallback() {}
-    StencilCallback(bool n) {
-        f_ = [=](std::ostream& os){ os << (n ? "true" : "false"); };
+    // lLȂ(stencilĂяo̊S̊ԂL)
+    StencilCallback() : kind_(kind_none) {}
+    StencilCallback(bool n) : kind_(kind_cstr) {
+        u_.s = n ? "true" : "false";
     }
-    StencilCallback(int n) {
-        f_ = [=](std::ostream& os){ os << std::to_string(n); };
+    StencilCallback(int n) : kind_(kind_int) {
+        u_.n = n;
     }
-    StencilCallback(size_t n) {
-        f_ = [=](std::ostream& os){ os << std::to_string(n); };
+    StencilCallback(size_t n) : kind_(kind_size) {
+        u_.z = n;
     }
-    StencilCallback(const char* ss) {
-        std::string s(ss);
-        f_ = [=](std::ostream& os){ os << s; };
+    StencilCallback(const char* ss) : kind_(kind_cstr) {
+        u_.s = ss;
     }
-    StencilCallback(const std::string& s) {
-        f_ = [=](std::ostream& os){ os << s; };
+    StencilCallback(const std::string& s) : kind_(kind_string) {
+        u_.str = &s;
     }
     template <class F>
-    StencilCallback(F f) {
-        f_ = f;
+    StencilCallback(const F& f) : kind_(kind_function) {
+        u_.f.p = &f;
+        u_.f.thunk = &call<F>;
     }
 
     void operator()(std::ostream& os) const {
-        f_(os);
+        switch (kind_) {
+            case kind_none:     break;
+            case kind_int:      os << u_.n; break;
+            case kind_size:     os << u_.z; break;
+            case kind_cstr:     os << u_.s; break;
+            case kind_string:   os.write(u_.str->data(), u_.str->size()); break;
+            case kind_function: u_.f.thunk(u_.f.p, os); break;
+        }
     }
 
 private:
-    std::function<void (std::ostream&)> f_;
-    
-};
+    template <class F>
+    static void call(const void* p, std::ostream& os) {
+        (*static_cast<const F*>(p))(os);
+    }
 
-void stencil_output(
-    std::ostream& os,
-    const char* t,
-    const std::map<std::string, StencilCallback>& m);
+    enum kind_type {
+        kind_none,
+        kind_int,
+        kind_size,
+        kind_cstr,
+        kind_string,
+        kind_function,
+    };
+
+    kind_type kind_;
+    union {
+        int                 n;
+        size_t              z;
+        const char*         s;
+        const std::string*  str;
+        struct {
+            const void* p;
+            void (*thunk)(const void*, std::ostream&);
+        } f;
+    } u_;
+
+};
 
 struct StencilBinding {
-    std::string     name;
+    const char*     name;
     StencilCallback callback;
 
-    StencilBinding(const std::string& n, StencilCallback cb)
+    StencilBinding(const char* n, StencilCallback cb)
         : name(n), callback{ cb } {}
 private:
     StencilBinding& operator=(const StencilBinding&) = delete;
     StencilBinding(const StencilBinding&) = delete;
 };
 
-inline
-void stencil_setup(std::map<std::string, StencilCallback>&) {
-}
-
-template <class ...T>
-void stencil_setup(
-    std::map<std::string, StencilCallback>& m,
-    const StencilBinding& b,
-    T... args) {
-    assert(!b.name.empty());
-    m[b.name] = b.callback;
-    stencil_setup(m, args...);
-}
+// t͕񃊃e(ÓIL)ł邱
+// ĂяoɃe/Xbg̗ɃRpCA|C^L[
+// LbV
+void stencil_output(
+    std::ostream& os,
+    const char* t,
+    const StencilBinding* const* bindings,
+    size_t binding_count);
 
 inline
 void stencil(
     std::ostream& os, const char* t
     ) {
-    std::map<std::string, StencilCallback> m;
-    stencil_output(os, t, m);
+    stencil_output(os, t, nullptr, 0);
 }
 
 inline
@@ -91,9 +111,9 @@ void stencil(
     std::ostream& os, const char* t,
     const StencilBinding& b0
     ) {
-    std::map<std::string, StencilCallback> m;
-    stencil_setup(m, std::cref(b0));
-    stencil_output(os, t, m);
+    const StencilBinding* const b[] = {
+        &b0 };
+    stencil_output(os, t, b, 1);
 }
 
 inline
@@ -102,9 +122,9 @@ void stencil(
     const StencilBinding& b0,
     const StencilBinding& b1
     ) {
-    std::map<std::string, StencilCallback> m;
-    stencil_setup(m, std::cref(b0), std::cref(b1));
-    stencil_output(os, t, m);
+    const StencilBinding* const b[] = {
+        &b0, &b1 };
+    stencil_output(os, t, b, 2);
 }
 
 inline
@@ -114,9 +134,9 @@ void stencil(
     const StencilBinding& b1,
     const StencilBinding& b2
     ) {
-    std::map<std::string, StencilCallback> m;
-    stencil_setup(m, std::cref(b0), std::cref(b1), std::cref(b2));
-    stencil_output(os, t, m);
+    const StencilBinding* const b[] = {
+        &b0, &b1, &b2 };
+    stencil_output(os, t, b, 3);
 }
 
 inline
@@ -127,9 +147,9 @@ void stencil(
     const StencilBinding& b2,
     const StencilBinding& b3
     ) {
-    std::map<std::string, StencilCallback> m;
-    stencil_setup(m, std::cref(b0), std::cref(b1), std::cref(b2), std::cref(b3));
-    stencil_output(os, t, m);
+    const StencilBinding* const b[] = {
+        &b0, &b1, &b2, &b3 };
+    stencil_output(os, t, b, 4);
 }
 
 inline
@@ -141,10 +161,9 @@ void stencil(
     const StencilBinding& b3,
     const StencilBinding& b4
     ) {
-    std::map<std::string, StencilCallback> m;
-    stencil_setup(m, std::cref(b0), std::cref(b1), std::cref(b2),
-                  std::cref(b3), std::cref(b4));
-    stencil_output(os, t, m);
+    const StencilBinding* const b[] = {
+        &b0, &b1, &b2, &b3, &b4 };
+    stencil_output(os, t, b, 5);
 }
 
 inline
@@ -157,10 +176,9 @@ void stencil(
     const StencilBinding& b4,
     const StencilBinding& b5
     ) {
-    std::map<std::string, StencilCallback> m;
-    stencil_setup(m, std::cref(b0), std::cref(b1), std::cref(b2),
-                  std::cref(b3), std::cref(b4), std::cref(b5));
-    stencil_output(os, t, m);
+    const StencilBinding* const b[] = {
+        &b0, &b1, &b2, &b3, &b4, &b5 };
+    stencil_output(os, t, b, 6);
 }
 
 inline
@@ -174,11 +192,10 @@ void stencil(
     const StencilBinding& b5,
     const StencilBinding& b6
     ) {
-    std::map<std::string, StencilCallback> m;
-    stencil_setup(m, std::cref(b0), std::cref(b1), std::cref(b2),
-                  std::cref(b3), std::cref(b4), std::cref(b5),
-                  std::cref(b6));
-    stencil_output(os, t, m);
+    const StencilBinding* const b[] = {
+        &b0, &b1, &b2, &b3, &b4, &b5,
+        &b6 };
+    stencil_output(os, t, b, 7);
 }
 
 inline
@@ -193,11 +210,10 @@ void stencil(
     const StencilBinding& b6,
     const StencilBinding& b7
     ) {
-    std::map<std::string, StencilCallback> m;
-    stencil_setup(m, std::cref(b0), std::cref(b1), std::cref(b2),
-                  std::cref(b3), std::cref(b4), std::cref(b5),
-                  std::cref(b6), std::cref(b7));
-    stencil_output(os, t, m);
+    const StencilBinding* const b[] = {
+        &b0, &b1, &b2, &b3, &b4, &b5,
+        &b6, &b7 };
+    stencil_output(os, t, b, 8);
 }
 
 inline
@@ -213,11 +229,10 @@ void stencil(
     const StencilBinding& b7,
     const StencilBinding& b8
     ) {
-    std::map<std::string, StencilCallback> m;
-    stencil_setup(m, std::cref(b0), std::cref(b1), std::cref(b2),
-                  std::cref(b3), std::cref(b4), std::cref(b5),
-                  std::cref(b6), std::cref(b7), std::cref(b8));
-    stencil_output(os, t, m);
+    const StencilBinding* const b[] = {
+        &b0, &b1, &b2, &b3, &b4, &b5,
+        &b6, &b7, &b8 };
+    stencil_output(os, t, b, 9);
 }
 
 inline
@@ -234,12 +249,10 @@ void stencil(
     const StencilBinding& b8,
     const StencilBinding& b9
     ) {
-    std::map<std::string, StencilCallback> m;
-    stencil_setup(m, std::cref(b0), std::cref(b1), std::cref(b2),
-                  std::cref(b3), std::cref(b4), std::cref(b5),
-                  std::cref(b6), std::cref(b7), std::cref(b8),
-                  std::cref(b9));
-    stencil_output(os, t, m);
+    const StencilBinding* const b[] = {
+        &b0, &b1, &b2, &b3, &b4, &b5,
+        &b6, &b7, &b8, &b9 };
+    stencil_output(os, t, b, 10);
 }
 
 inline
@@ -257,12 +270,10 @@ void stencil(
     const StencilBinding& b9,
     const StencilBinding& b10
     ) {
-    std::map<std::string, StencilCallback> m;
-    stencil_setup(m, std::cref(b0), std::cref(b1), std::cref(b2),
-                  std::cref(b3), std::cref(b4), std::cref(b5),
-                  std::cref(b6), std::cref(b7), std::cref(b8),
-                  std::cref(b9), std::cref(b10));
-    stencil_output(os, t, m);
+    const StencilBinding* const b[] = {
+        &b0, &b1, &b2, &b3, &b4, &b5,
+        &b6, &b7, &b8, &b9, &b10 };
+    stencil_output(os, t, b, 11);
 }
 
 #endif // CAPER_STENCIL_HPP_
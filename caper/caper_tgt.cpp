@@ -90,6 +90,60 @@ void collect_informations(
             // %dont_use_stl錾
             options.dont_use_stl = true;
         }
+        if (auto tabledrivendecl = downcast<TableDrivenDecl>(x)) {
+            // %table_driven錾
+            options.table_driven = true;
+        }
+        if (auto computedgotodecl = downcast<ComputedGotoDecl>(x)) {
+            // %computed_goto錾
+            options.computed_goto = true;
+        }
+        if (auto typedstackdecl = downcast<TypedStackDecl>(x)) {
+            // %typed_stack錾
+            options.typed_stack = true;
+        }
+        if (auto streamingsequencedecl = downcast<StreamingSequenceDecl>(x)) {
+            // %streaming_sequence錾
+            options.streaming_sequence = true;
+        }
+        if (auto arenadecl = downcast<ArenaDecl>(x)) {
+            // %arena錾
+            options.arena = true;
+        }
+        if (auto profiledecl = downcast<ProfileDecl>(x)) {
+            // %profile錾
+            options.profile = true;
+        }
+        if (auto splitimplementationdecl = downcast<SplitImplementationDecl>(x)) {
+            // %split_implementation錾
+            options.split_implementation = true;
+        }
+        if (auto constexprdecl = downcast<ConstexprDecl>(x)) {
+            // %constexpr錾
+            options.constexpr_tables = true;
+        }
+        if (auto glrdecl = downcast<GlrDecl>(x)) {
+            // %glr錾
+            options.glr = true;
+        }
+        if (auto incrementaldecl = downcast<IncrementalDecl>(x)) {
+            // %incremental錾
+            options.incremental = true;
+        }
+        if (auto lexdecl = downcast<LexDecl>(x)) {
+            // %lex錾
+            options.lex_rules.push_back(
+                LexRule(lexdecl->range.beg, lexdecl->name, lexdecl->pattern));
+        }
+        if (auto recoversyncdecl = downcast<RecoverSyncDecl>(x)) {
+            // %recover_sync錾
+            options.recovery_sync = true;
+        }
+        if (auto paralleldecl = downcast<ParallelDecl>(x)) {
+            // %parallel錾
+            options.parallel_element = paralleldecl->name;
+            options.parallel_addr = paralleldecl->range.beg;
+        }
         if (auto valuetypedecl = downcast<ValueTypeDecl>(x)) {
             // %value_type錾
             std::size_t last_dot_pos = valuetypedecl->name.rfind('.');
@@ -102,6 +156,13 @@ void collect_informations(
         }
     }
 
+    // %lex̑Ώۂ͏I[L
+    for (const auto& x: options.lex_rules) {
+        if (!x.token.empty() && terminal_types.count(x.token) == 0) {
+            throw undefined_symbol(x.addr, x.token);
+        }
+    }
+
     // K
     for (const auto& rule: doc->rules->rules) {
         if (known.find(rule->name) != known.end()) {
@@ -123,6 +184,13 @@ void collect_informations(
             throw undefined_symbol(-1, x);
         }
     }
+
+    // %parallel̑Ώۂ͊m̋L
+    if (!options.parallel_element.empty() &&
+        known.count(options.parallel_element) == 0) {
+        throw undefined_symbol(
+            options.parallel_addr, options.parallel_element);
+    }
 }
 
 template <class T, class V>
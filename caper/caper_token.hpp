@@ -12,6 +12,7 @@ enum Token {
     token_identifier,
     token_integer,
     token_typetag,
+    token_string,
     token_colon,
     token_semicolon,
     token_pipe,
@@ -34,6 +35,19 @@ enum Token {
     token_directive_dont_use_stl,
     token_directive_value_type,
     token_directive_smart_pointer,
+    token_directive_table_driven,
+    token_directive_computed_goto,
+    token_directive_typed_stack,
+    token_directive_streaming_sequence,
+    token_directive_arena,
+    token_directive_profile,
+    token_directive_split_implementation,
+    token_directive_constexpr,
+    token_directive_glr,
+    token_directive_incremental,
+    token_directive_lex,
+    token_directive_parallel,
+    token_directive_recover_sync,
     token_eof,
 };
 
@@ -49,6 +63,7 @@ const char* token_labels(Token op) {
         "IDENT",
         "number",
         "<type>",
+        "string",
         ":",
         ";",
         "|",
@@ -72,6 +87,19 @@ const char* token_labels(Token op) {
         "%dont_use_stl",
         "%value_type",
         "%smart_pointer",
+        "%table_driven",
+        "%computed_goto",
+        "%typed_stack",
+        "%streaming_sequence",
+        "%arena",
+        "%profile",
+        "%split_implementation",
+        "%constexpr",
+        "%glr",
+        "%incremental",
+        "%lex",
+        "%parallel",
+        "%recover_sync",
         "$"
     };
 
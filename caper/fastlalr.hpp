@@ -346,6 +346,7 @@ make_lalr_table(
 
             // conflictłacceptreducëƂ݂Ȃ
             bool add_action = true;
+            bool displaced = false;
 
             auto k = s.action_table.find(x.lookahead().token());
             if (k != s.action_table.end()) {
@@ -359,25 +360,39 @@ make_lalr_table(
                     rrr(krule, x.rule());
                     // ႢD
                     add_action = x.rule().id() < (*k).second.rule.id(); 
+                    displaced = add_action;
                 }
             }
 
-            if (!add_action) { continue; }
-
+            Token token;
+            action_type action;
             if (x.rule() == g.root_rule()) {
                 // c)[S'SE, $]Ji̗vfȂ΁A
                 // action[i, $]"accept"B
 
-                s.action_table[Traits::eof()] = action_type(
+                token = Traits::eof();
+                action = action_type(
                     action_accept, 0xdeadbeaf, g.root_rule());
             } else {
                 // b)[AE, a]Ji̗vfłA
                 // ASȂ΁Aaction[i, a]
                 // "reduce A"B
 
-                s.action_table[x.lookahead().token()] = action_type(
+                token = x.lookahead().token();
+                action = action_type(
                     action_reduce, 0xdeadbeaf, x.rule());
             }                    
+
+            // ̗pȂGLRpɎcĂ
+            if (!add_action) {
+                s.alternatives.insert(std::make_pair(token, action));
+                continue;
+            }
+            if (displaced) {
+                s.alternatives.insert(*k);
+            }
+
+            s.action_table[token] = action;
         }
 
         // iɑ΂s֐́A
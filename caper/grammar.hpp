@@ -14,7 +14,9 @@
 #include <iostream>
 #include <cassert>
 #include <algorithm>
+#include <cstdint>
 #include <memory>
+#include <mutex>
 #include <set>
 #include <unordered_set>
 #include <unordered_map>
@@ -158,30 +160,53 @@ template <class Token, class Traits>
 class nonterminal {
 private:
     static const std::string* intern(const std::string& s) {
+        static std::mutex m;
         static std::set<std::string> env;
+        std::lock_guard<std::mutex> lock(m);
         return &(*(env.insert(s).first));
     }
 
+    static std::uint64_t make_key(const std::string& s) {
+        // FNV-1a
+        std::uint64_t h = 14695981039346656037ULL;
+        for (char c: s) {
+            h ^= std::uint64_t((unsigned char)c);
+            h *= 1099511628211ULL;
+        }
+        return h;
+    }
+
+    nonterminal(const std::string* n, std::uint64_t k) : name_(n), key_(k) {}
+
 public:
     nonterminal() {}
-    explicit nonterminal(const std::string& x) : name_(intern(x)) {}
-    explicit nonterminal(const std::string* n) : name_(n) {}
-    nonterminal(const nonterminal<Token, Traits>& x) : name_(x.name_) {}
+    explicit nonterminal(const std::string& x)
+        : name_(intern(x)), key_(make_key(x)) {}
+    explicit nonterminal(const std::string* n)
+        : name_(n), key_(make_key(*n)) {}
+    nonterminal(const nonterminal<Token, Traits>& x)
+        : name_(x.name_), key_(x.key_) {}
 
     const std::string& name() const { return *name_; }
     const std::string* identity() const { return name_; }
 
     nonterminal<Token,Traits>& operator=(const nonterminal<Token, Traits>& x) {
         name_ = x.name_;
+        key_ = x.key_;
         return *this;
     }
 
     int cmp(const nonterminal<Token, Traits>& y) const {
-        return name_ - y.name_;
+        // order by content (hash, then name), not by address, so that
+        // generated code does not depend on the order of interning
+        if (name_ == y.name_) { return 0; }
+        if (key_ != y.key_) { return key_ < y.key_ ? -1 : 1; }
+        return name_->compare(*y.name_);
     }
 
 private:
     const std::string* name_;
+    std::uint64_t      key_;
         
     friend bool operator== <>(const nonterminal<Token, Traits>& x,
                               const nonterminal<Token, Traits>& y);
@@ -263,18 +288,20 @@ public:
     symbol() : type_( type_epsilon ) {}
     symbol(const symbol<Token, Traits>& x)
         : type_(x.type_),
-          token_(x.token_), display_(x.display_), name_(x.name_) {}
+          token_(x.token_), display_(x.display_),
+          name_(x.name_), key_(x.key_) {}
     symbol(const epsilon<Token, Traits>&) : type_(type_epsilon) {}
     symbol(const terminal<Token, Traits>& x)
         : type_(type_terminal), token_(x.token_), display_(x.display_) {}
     symbol(const nonterminal<Token, Traits>& x)
-        : type_(type_nonterminal), name_(x.name_) {}
+        : type_(type_nonterminal), name_(x.name_), key_(x.key_) {}
 
     symbol<Token, Traits>& operator=(const symbol<Token, Traits>& x) {
         type_ = x.type_;
         token_ = x.token_;
         display_ = x.display_;
         name_ = x.name_;
+        key_ = x.key_;
         return *this;
     }
     symbol<Token, Traits>& operator=(const epsilon<Token, Traits>&) {
@@ -290,6 +317,7 @@ public:
     symbol<Token, Traits>& operator=(const nonterminal<Token, Traits>& x) {
         type_ = type_nonterminal;
         name_ = x.name_;
+        key_ = x.key_;
         return *this;
     }
         
@@ -302,7 +330,7 @@ public:
     }
     nonterminal<Token, Traits> as_nonterminal() const {
         assert(is_nonterminal());
-        return nonterminal<Token, Traits>(name_);
+        return nonterminal<Token, Traits>(name_, key_);
     }
     Token token() const {
         assert(is_terminal());
@@ -328,7 +356,10 @@ public:
         switch (type_) {
             case symbol_type::type_epsilon:      return 0;
             case symbol_type::type_terminal:     return token_ - y.token_;
-            case symbol_type::type_nonterminal:  return name_ - y.name_;
+            case symbol_type::type_nonterminal:
+                if (name_ == y.name_) { return 0; }
+                if (key_ != y.key_) { return key_ < y.key_ ? -1 : 1; }
+                return name_->compare(*y.name_);
             default: assert(0);     return 0;
         }
     }
@@ -338,6 +369,7 @@ private:
     Token               token_;
     std::string         display_;
     const std::string*  name_;
+    std::uint64_t       key_;
 
     friend class rule<Token, Traits>;
     friend bool operator== <>(const symbol<Token, Traits>& x,
@@ -620,10 +620,6 @@ make_lr1_closure(
 
     item_set_type Jdash = J; // ̃Ce[VŃ\[Xɂ鍀
 
-    static int call_count = 0;
-    
-    //std::cerr << "make_lr1_closure start: " << call_count << std::endl;
-    call_count++;
     while(true) {
         //std::cerr << "J.size() = " << J.size() << ", Jdash.size() = " << Jdash.size() << std::endl;
         item_set_type new_items;  // }鍀
@@ -844,6 +840,7 @@ public:
         typedef item_set<Token, Traits>                 item_set_type;
         typedef core_set<Token, Traits>                 core_set_type;
         typedef std::map<Token, action>                 action_table_type;
+        typedef std::multimap<Token, action>            alternatives_type;
         typedef std::map<symbol_type, int>              goto_table_type; // index to states_
         typedef std::map<core_type, terminal_set_type>  generate_map_type;
         typedef std::set<std::pair<int, core_type>>     propagate_type;
@@ -858,6 +855,7 @@ public:
 
         goto_table_type         goto_table;
         action_table_type       action_table;
+        alternatives_type       alternatives;   // ō̗pȂ(GLRp)
         bool                    handle_error    = false;
 
         state(int n) : no(n) {}
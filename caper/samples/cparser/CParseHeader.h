@@ -13,6 +13,22 @@
 
 namespace cparser
 {
+    struct TokenOf
+    {
+        Token operator()(const TokenValue& info) const
+        {
+            return info.m_token;
+        }
+    };
+
+    struct NodeOf
+    {
+        shared_ptr<Node> operator()(const TokenValue& info) const
+        {
+            return make_shared<TokenValue >(info);
+        }
+    };
+
     template <class Iterator>
     bool parse(shared_ptr<TransUnit>& tu, Iterator begin, Iterator end,
                bool is_64bit = false)
@@ -30,23 +46,13 @@ namespace cparser
         #endif
 
         Parser<shared_ptr<Node>, ParserSite> parser(ps);
-        std::vector<TokenValue >::iterator it, end2 = infos.end();
-        for (it = infos.begin(); it != end2; ++it)
+        std::vector<TokenValue >::iterator it =
+            parser.post_range(infos.begin(), infos.end(), TokenOf(), NodeOf());
+        if (it != infos.end() && parser.error())
         {
-            #if 0
-                printf("%s\n", scanner.token_to_string(*it).c_str());
-                fflush(stdout);
-            #endif
-            if (parser.post(it->m_token, make_shared<TokenValue >(*it)))
-            {
-                if (parser.error())
-                {
-                    ps.location() = it->location();
-                    ps.message(std::string("ERROR: syntax error near ") +
-                        scanner.token_to_string(*it));
-                }
-                break;
-            }
+            ps.location() = it->location();
+            ps.message(std::string("ERROR: syntax error near ") +
+                scanner.token_to_string(*it));
         }
 
         shared_ptr<Node> node;
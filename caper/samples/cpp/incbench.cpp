@@ -0,0 +1,159 @@
+// benchmark for %incremental: replays a trace of random edits over a long
+// token sequence with incremental.ipp, reparsing after each edit, and
+// checks every result against a parse from scratch
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include "incremental.ipp"
+
+using namespace incremental;
+
+struct SemanticAction {
+    void syntax_error() {}
+    void stack_overflow() {}
+    void downcast(unsigned& x, unsigned y) { x = y; }
+    void upcast(unsigned& x, unsigned y) { x = y; }
+
+    unsigned Identity(unsigned x) { return x; }
+    unsigned Zero() { return 0; }
+    unsigned Mix(unsigned x, unsigned y) { return x * 31 + y; }
+};
+
+struct Lexeme {
+    Token       token;
+    unsigned    value;
+
+    Lexeme(Token t, unsigned v = 0) : token(t), value(v) {}
+};
+
+typedef std::vector<Lexeme> Lexemes;
+typedef Parser<unsigned, SemanticAction> parser_type;
+
+Token token_of(const Lexeme& x) { return x.token; }
+unsigned value_of(const Lexeme& x) { return x.value; }
+
+unsigned pick(unsigned n) {
+    static unsigned long long seed = 88172645463325252ULL;
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+    return unsigned(seed % n);
+}
+
+void statement(Lexemes& v) {
+    v.push_back(Lexeme(token_Ident, pick(100)));
+    v.push_back(Lexeme(token_Assign));
+    v.push_back(Lexeme(token_Number, pick(1000)));
+    for (unsigned i = pick(4) ; 0 < i ; i--) {
+        v.push_back(Lexeme(token_Plus));
+        v.push_back(Lexeme(token_Ident, pick(100)));
+    }
+    v.push_back(Lexeme(token_Semi));
+}
+
+void block(Lexemes& v, int statements, int depth) {
+    v.push_back(Lexeme(token_LBrace));
+    for (int i = 0 ; i < statements ; i++) {
+        if (0 < depth && pick(10) == 0) {
+            block(v, statements / 4, depth - 1);
+        } else {
+            statement(v);
+        }
+    }
+    v.push_back(Lexeme(token_RBrace));
+}
+
+// one edit of the trace: [first, first + removed) of v is replaced by
+// inserted tokens
+void edit(Lexemes& v, size_t& first, size_t& removed, size_t& inserted) {
+    Lexemes s;
+    switch (pick(3)) {
+    case 0:
+        // change a number
+        do { first = pick(unsigned(v.size())); }
+        while (v[first].token != token_Number);
+        removed = inserted = 1;
+        v[first].value = pick(1000);
+        return;
+    case 1:
+        // add a statement after another
+        do { first = pick(unsigned(v.size())); }
+        while (v[first].token != token_Semi);
+        first++;
+        removed = 0;
+        statement(s);
+        break;
+    default:
+        // remove a statement
+        do { first = pick(unsigned(v.size() - 1)); }
+        while (v[first].token != token_Ident ||
+               v[first + 1].token != token_Assign);
+        removed = 1;
+        while (v[first + removed - 1].token != token_Semi) { removed++; }
+        break;
+    }
+    v.erase(v.begin() + first, v.begin() + first + removed);
+    v.insert(v.begin() + first, s.begin(), s.end());
+    inserted = s.size();
+}
+
+int main(int argc, char** argv) {
+    int functions = 200;
+    int edits = 2000;
+    if (1 < argc) { edits = atoi(argv[1]); }
+
+    Lexemes v;
+    for (int i = 0 ; i < functions ; i++) {
+        v.push_back(Lexeme(token_Fn));
+        v.push_back(Lexeme(token_Ident, pick(100)));
+        block(v, 40, 2);
+    }
+    v.push_back(Lexeme(token_eof));
+
+    SemanticAction sa;
+    parser_type incremental(sa);
+    parser_type scratch(sa);
+    unsigned x = 0, y = 0;
+    if (!incremental.reparse(v.begin(), v.end(), token_of, value_of,
+                             0, 0, 0, x)) {
+        std::cerr << "error occured" << std::endl;
+        return 1;
+    }
+
+    typedef std::chrono::steady_clock clock;
+    clock::duration reparse_time(0), parse_time(0);
+    for (int k = 0 ; k < edits ; k++) {
+        size_t first, removed, inserted;
+        edit(v, first, removed, inserted);
+
+        clock::time_point t0 = clock::now();
+        bool f = incremental.reparse(
+            v.begin(), v.end(), token_of, value_of,
+            first, removed, inserted, x);
+        clock::time_point t1 = clock::now();
+        scratch.reset();
+        scratch.post_range(v.begin(), v.end(), token_of, value_of);
+        bool g = !scratch.error() && scratch.accept(y);
+        clock::time_point t2 = clock::now();
+        reparse_time += t1 - t0;
+        parse_time += t2 - t1;
+
+        if (!f || !g || x != y) {
+            std::cerr << "edit " << k << " differs" << std::endl;
+            return 1;
+        }
+    }
+
+    double a = double(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            reparse_time).count()) / edits;
+    double b = double(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            parse_time).count()) / edits;
+    std::cout << v.size() << " tokens, " << edits << " edits: "
+              << a / 1000 << " us/reparse, " << b / 1000 << " us/parse"
+              << " (" << x << ")" << std::endl;
+    return 0;
+}
@@ -0,0 +1,229 @@
+// benchmark for %lex: scans a long generated expression with the Lexer of
+// lexcalc.ipp and with a getc/ungetc scanner in the style of calc2.cpp, over
+// the buffer and over a std::istreambuf_iterator as calc2.cpp reads std::cin
+// (here a std::istringstream of the buffer), and checks all see the same
+// tokens; each figure is the best of a few rounds
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include "lexcalc.ipp"
+
+using namespace lexcalc;
+
+struct SemanticAction {
+    void lexeme(Token t, const char* b, const char* e, int& v) {
+        v = 0;
+        if (t == token_Number) {
+            for (; b != e ; ++b) { v = v * 10 + (*b - '0'); }
+        }
+    }
+};
+
+class unexpected_char : public std::exception {};
+
+template <class It>
+class scanner {
+public:
+    typedef int char_type;
+    static const char_type eof = -1;
+
+public:
+    scanner(It b, It e) : c_(b), e_(e), unget_(eof) {}
+
+    Token get(int& v) {
+        int c;
+      retry:
+        do {
+            c = getc();
+        } while (isspace(c));
+
+        if (c == '#') {
+            while ((c = getc()) != eof && c != '\n')
+                ;
+            goto retry;
+        }
+
+        v = 0;
+        switch (c) {
+            case '+': return token_Add;
+            case '-': return token_Sub;
+            case '*': return token_Mul;
+            case '/': return token_Div;
+            case '(': return token_LParen;
+            case ')': return token_RParen;
+        }
+        if (c == eof) {
+            return token_eof;
+        }
+
+        if (isdigit(c)) {
+            int n = 0;
+            while (c != eof && isdigit(c)) {
+                n *= 10;
+                n += c - '0';
+                c = getc();
+            }
+            ungetc(c);
+            v = n;
+            return token_Number;
+        }
+
+        throw unexpected_char();
+    }
+
+private:
+    char_type getc() {
+        int c;
+        if (unget_ != eof) {
+            c = unget_;
+            unget_ = eof;
+        } else if (c_ == e_) {
+            c = eof;
+        } else {
+            c = (unsigned char)*c_++;
+        }
+        return c;
+    }
+
+    void ungetc(char_type c) {
+        if (c != eof) {
+            unget_ = c;
+        }
+    }
+
+private:
+    It          c_;
+    It          e_;
+    char_type   unget_;
+
+};
+
+unsigned pick(unsigned n) {
+    static unsigned long long seed = 88172645463325252ULL;
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+    return unsigned(seed % n);
+}
+
+void expression(std::string& s, int depth) {
+    static const char* const operators[] = { " + ", " - ", "*", " / " };
+    for (unsigned i = pick(8) + 1 ; ; i--) {
+        if (0 < depth && pick(4) == 0) {
+            s += "(";
+            expression(s, depth - 1);
+            s += ")";
+        } else {
+            s += std::to_string(pick(100000));
+        }
+        if (i == 1) { break; }
+        s += operators[pick(4)];
+        if (pick(16) == 0) { s += "  # note\n    "; }
+    }
+}
+
+typedef std::chrono::steady_clock clock_type;
+
+struct Scan {
+    unsigned long long  hash;
+    size_t              tokens;
+    double              seconds;
+};
+
+void mix(Scan& r, Token t, int v) {
+    r.hash = r.hash * 31 + unsigned(t) * 100003 + unsigned(v);
+    r.tokens++;
+}
+
+double seconds(clock_type::duration d) {
+    return double(
+        std::chrono::duration_cast<std::chrono::microseconds>(d).count()) /
+        1000000;
+}
+
+// runs f rounds times and keeps the fastest
+template <class F>
+Scan best(int rounds, F f) {
+    Scan r = { 0, 0, 0 };
+    for (int k = 0 ; k < rounds ; k++) {
+        clock_type::time_point t0 = clock_type::now();
+        Scan x = f();
+        x.seconds = seconds(clock_type::now() - t0);
+        if (k == 0 || x.seconds < r.seconds) { r = x; }
+    }
+    return r;
+}
+
+int main(int argc, char** argv) {
+    size_t size = 1 << 26;
+    int rounds = 3;
+    if (1 < argc) { size = size_t(atol(argv[1])); }
+    if (2 < argc) { rounds = atoi(argv[2]); }
+
+    std::string s;
+    while (s.size() < size) {
+        expression(s, 4);
+        s += "\n+ ";
+    }
+    s += "0\n";
+    const char* first = s.data();
+    const char* last = first + s.size();
+
+    double mb = double(s.size()) / (1 << 20);
+    Scan lex = best(rounds, [&]() {
+        SemanticAction sa;
+        Lexer<int, SemanticAction> lexer(sa, first, last);
+        Scan r = { 0, 0, 0 };
+        for (;;) {
+            int v;
+            Token t = lexer.next(v);
+            if (t == token_eof) { break; }
+            mix(r, t, v);
+        }
+        if (lexer.error()) { r.tokens = 0; }
+        return r;
+    });
+    Scan buffer = best(rounds, [&]() {
+        scanner<const char*> hand(first, last);
+        Scan r = { 0, 0, 0 };
+        for (;;) {
+            int v;
+            Token t = hand.get(v);
+            if (t == token_eof) { break; }
+            mix(r, t, v);
+        }
+        return r;
+    });
+    std::istringstream in(s);
+    Scan stream = best(rounds, [&]() {
+        typedef std::istreambuf_iterator<char> is_iterator;
+        in.clear();
+        in.seekg(0);
+        scanner<is_iterator> hand((is_iterator(in)), is_iterator());
+        Scan r = { 0, 0, 0 };
+        for (;;) {
+            int v;
+            Token t = hand.get(v);
+            if (t == token_eof) { break; }
+            mix(r, t, v);
+        }
+        return r;
+    });
+
+    if (lex.tokens == 0 ||
+        lex.hash != buffer.hash || lex.tokens != buffer.tokens ||
+        lex.hash != stream.hash || lex.tokens != stream.tokens) {
+        std::cerr << "scanners differ" << std::endl;
+        return 1;
+    }
+
+    std::cout << s.size() << " bytes, " << lex.tokens << " tokens: "
+              << mb / lex.seconds << " MB/s %lex, "
+              << mb / buffer.seconds << " MB/s getc buffer, "
+              << mb / stream.seconds << " MB/s getc istream" << std::endl;
+    return 0;
+}
@@ -0,0 +1,56 @@
+// calculator scanned by the %lex rules of lexcalc.cpg
+
+#include "lexcalc.ipp"
+#include <iostream>
+#include <iterator>
+#include <string>
+
+using namespace lexcalc;
+
+struct SemanticAction {
+    void syntax_error() {}
+    void stack_overflow() {}
+    void downcast(int& x, int y) { x = y; }
+    void upcast(int& x, int y) { x = y; }
+
+    void lexeme(Token t, const char* b, const char* e, int& v) {
+        v = 0;
+        if (t == token_Number) {
+            for (; b != e ; ++b) { v = v * 10 + (*b - '0'); }
+        }
+    }
+
+    int Identity(int n) { return n; }
+    int MakeAdd(int x, int y) { return x + y; }
+    int MakeSub(int x, int y) { return x - y; }
+    int MakeMul(int x, int y) { return x * y; }
+    int MakeDiv(int x, int y) { return x / y; }
+};
+
+int main(int, char**) {
+    std::string s((std::istreambuf_iterator<char>(std::cin)),
+                  std::istreambuf_iterator<char>());
+
+    SemanticAction sa;
+    Lexer<int, SemanticAction> lexer(sa, s.data(), s.data() + s.size());
+    Parser<int, SemanticAction> parser(sa);
+
+    for (;;) {
+        int v;
+        Token token = lexer.next(v);
+        if (parser.post(token, v)) { break; }
+    }
+    if (lexer.error()) {
+        std::cerr << "unexpected char at "
+                  << lexer.position() - s.data() << std::endl;
+        return 1;
+    }
+
+    int v;
+    if (parser.accept(v)) {
+        std::cerr << "accepted\n";
+        std::cerr << v << std::endl;
+    }
+
+    return 0;
+}
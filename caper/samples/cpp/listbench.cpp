@@ -0,0 +1,74 @@
+// micro-benchmark for the EBNF sequence support: parses the same long
+// list repeatedly with list0.ipp ('*'), list1.ipp ('+') or list2.ipp
+// ('/' with Comma), selected by LIST_IPP
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#ifndef LIST_IPP
+#define LIST_IPP "list2.ipp"
+#endif
+#include LIST_IPP
+
+struct SemanticAction {
+    void syntax_error() {}
+    void stack_overflow() {}
+    void downcast(int& x, int y) { x = y; }
+    void upcast(int& x, int y) { x = y; }
+
+    template <class S>
+    int Document(const S& x) {
+        int n = 0;
+        for(typename S::const_iterator i = x.begin();i!=x.end();++i) {
+            n += *i;
+        }
+        return n;
+    }
+
+};
+
+int main( int argc, char** argv )
+{
+    int length = 500;       // must fit the default stack (1024 frames)
+    int iterations = 20000;
+    if (1 < argc) { iterations = atoi(argv[1]); }
+
+    std::vector<list::Token> tokens;
+    tokens.push_back(list::token_LParen);
+    for (int i = 0 ; i < length ; i++) {
+#ifdef LIST_COMMA
+        if (i != 0) { tokens.push_back(list::token_Comma); }
+#endif
+        tokens.push_back(list::token_Number);
+    }
+    tokens.push_back(list::token_RParen);
+    tokens.push_back(list::token_eof);
+
+    SemanticAction sa;
+    long long total = 0;
+    std::chrono::steady_clock::time_point t0 =
+        std::chrono::steady_clock::now();
+    for (int k = 0 ; k < iterations ; k++) {
+        list::Parser<int, SemanticAction> parser(sa);
+        for (size_t i = 0 ; i < tokens.size() ; i++) {
+            if (parser.post(tokens[i], 1)) { break; }
+        }
+        int v;
+        if (parser.error() || !parser.accept(v)) {
+            std::cerr << "error occured" << std::endl;
+            return 1;
+        }
+        total += v;
+    }
+    std::chrono::steady_clock::time_point t1 =
+        std::chrono::steady_clock::now();
+
+    double ns = double(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count());
+    std::cout << LIST_IPP << ": "
+              << ns / (double(tokens.size()) * iterations) << " ns/token"
+              << " (" << total << ")" << std::endl;
+    return 0;
+}
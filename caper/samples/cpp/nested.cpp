@@ -0,0 +1,74 @@
+// sums of nested lists with a %dont_use_stl parser that keeps 16 frames
+// inside itself and grows its stack through malloc when they run out, so
+// nesting is not limited by _StackSize; try
+//   python -c "print('(' * 100000 + '1' + ')' * 100000)" | ./nested
+
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <iterator>
+#include "nested.ipp"
+
+using namespace nested;
+
+struct SemanticAction {
+    void syntax_error() {}
+    void stack_overflow() {}
+    void downcast(int& x, int y) { x = y; }
+    void upcast(int& x, int y) { x = y; }
+
+    int Identity(int n) { return n; }
+
+    template <class S>
+    int Sum(const S& s) {
+        int n = 0;
+        for (typename S::const_iterator i = s.begin() ; i != s.end() ; ++i) {
+            n += *i;
+        }
+        return n;
+    }
+};
+
+void* stack_memory(void*, void* p, size_t size) {
+    if (size == 0) {
+        free(p);
+        return 0;
+    }
+    return malloc(size);
+}
+
+int main(int, char**) {
+    SemanticAction sa;
+    Parser<int, SemanticAction, 16> parser(sa);
+    parser.set_stack_allocator(stack_memory, 0);
+
+    int c = getchar();
+    for (;;) {
+        while (isspace(c)) { c = getchar(); }
+        Token token = token_eof;
+        int v = 0;
+        if (isdigit(c)) {
+            token = token_Number;
+            while (isdigit(c)) {
+                v = v * 10 + (c - '0');
+                c = getchar();
+            }
+        } else if (c == '(' || c == ')') {
+            token = c == '(' ? token_LParen : token_RParen;
+            c = getchar();
+        } else if (c != EOF) {
+            std::cerr << "unexpected char: " << char(c) << std::endl;
+            return 1;
+        }
+        if (parser.post(token, v)) { break; }
+    }
+
+    int v;
+    if (parser.error() || !parser.accept(v)) {
+        std::cerr << "error occured" << std::endl;
+        return 1;
+    }
+    std::cout << v << std::endl;
+    return 0;
+}
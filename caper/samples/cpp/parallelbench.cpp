@@ -0,0 +1,208 @@
+// benchmark for %parallel: a long log of records, scanned once by the
+// Lexer of parallel.ipp, is parsed sequentially with post_range() and with
+// parse_parallel() on 1, 2, 4 ... threads. A few records nest another in a
+// field, so some chunks start at an inner LBrace and are guessed wrong;
+// the entries and the syntax errors reported must agree every time
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+typedef std::vector<int> Entries;
+
+struct Value {
+    int     n;
+    Entries entries;    // the accumulator of Entry*
+
+    Value() : n(0) {}
+};
+
+#include "parallel.ipp"
+
+using namespace parallel;
+
+int mix(unsigned x, unsigned y) { return int((x + y) & 0x7fffffff); }
+
+struct SemanticAction {
+    int errors = 0;
+
+    void syntax_error() { errors++; }
+    void stack_overflow() {}
+    void downcast(int& x, const Value& v) { x = v.n; }
+    void upcast(Value& v, int x) { v.n = x; }
+    void downcast(Entries& x, const Value& v) { x = v.entries; }
+    void upcast(Value& v, Entries x) { v.entries.swap(x); }
+
+    void lexeme(Token, const char* b, const char* e, Value& v) {
+        unsigned h = 0;
+        for (; b != e ; ++b) { h = h * 31 + *b; }
+        v.n = mix(h, 0);
+    }
+
+    // %streaming_sequence
+    void append(Value& acc, int x) { acc.entries.push_back(x); }
+    // %parallel
+    void concat(Value& acc, Value&& chunk) {
+        acc.entries.insert(
+            acc.entries.end(), chunk.entries.begin(), chunk.entries.end());
+    }
+
+    template <class S>
+    Entries MakeLog(const S& s) {
+        return s.accumulator().entries;
+    }
+    int MakeEntry(int f) { return f ^ (f >> 7); }
+    int MakeFields(int x, int y) { return mix(x * 131u, y); }
+    int MakeField(int name, int value) { return mix(name * 31u, value); }
+    int Identity(int x) { return x; }
+};
+
+typedef Parser<Value, SemanticAction> parser_type;
+
+struct Lexeme {
+    Token   token;
+    int     n;
+};
+
+unsigned pick(unsigned n) {
+    static unsigned long long seed = 88172645463325252ULL;
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+    return unsigned(seed % n);
+}
+
+void generate(std::string& s, int depth) {
+    static const char* const names[] = {
+        "id", "host", "status", "bytes", "path", "agent", "latency"
+    };
+    s += "{ ";
+    for (unsigned i = pick(6) + 1 ; 0 < i ; i--) {
+        s += names[pick(7)];
+        s += ": ";
+        if (0 < depth && pick(16) == 0) {
+            generate(s, depth - 1);
+        } else if (pick(2)) {
+            s += std::to_string(pick(100000));
+        } else {
+            s += names[pick(7)];
+        }
+        s += 1 < i ? ", " : " ";
+    }
+    s += "}\n";
+}
+
+struct Result {
+    bool    accepted;
+    int     errors;
+    Entries entries;
+    double  ms;
+};
+
+template <class F>
+Result run(const std::vector<Lexeme>& tokens, int rounds, F f) {
+    typedef std::chrono::steady_clock clock;
+    Result r;
+    clock::time_point t0 = clock::now();
+    for (int k = 0 ; k < rounds ; k++) {
+        SemanticAction sa;
+        parser_type parser(sa);
+        Value v;
+        r.accepted = f(parser, tokens, v);
+        r.errors = sa.errors;
+        r.entries.swap(v.entries);
+    }
+    clock::time_point t1 = clock::now();
+    r.ms = std::chrono::duration_cast<std::chrono::microseconds>(
+        t1 - t0).count() / 1000.0 / rounds;
+    return r;
+}
+
+Token token_of(const Lexeme& x) { return x.token; }
+
+Value value_of(const Lexeme& x) {
+    Value v;
+    v.n = x.n;
+    return v;
+}
+
+bool is_boundary(const Lexeme& x) { return x.token == token_LBrace; }
+
+bool sequential(parser_type& parser, const std::vector<Lexeme>& tokens,
+                Value& v) {
+    parser.post_range(tokens.begin(), tokens.end(), token_of, value_of);
+    return !parser.error() && parser.accept(v);
+}
+
+int compare(const char* label, const Result& expected,
+            const std::vector<Lexeme>& tokens, int rounds,
+            unsigned int threads) {
+    Result r = run(tokens, rounds, [=](parser_type& parser,
+                                       const std::vector<Lexeme>& tokens,
+                                       Value& v) {
+            return parser.parse_parallel(
+                tokens.begin(), tokens.end(), token_of, value_of,
+                is_boundary, threads, v);
+        });
+    std::cout << label << " " << threads << " threads: " << r.ms << " ms ("
+              << expected.ms / r.ms << "x)" << std::endl;
+    if (r.accepted != expected.accepted || r.errors != expected.errors ||
+        r.entries != expected.entries) {
+        std::cerr << "results differ" << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    int records = 200000;
+    int rounds = 5;
+    if (1 < argc) { records = atoi(argv[1]); }
+    if (2 < argc) { rounds = atoi(argv[2]); }
+
+    std::string s;
+    for (int i = 0 ; i < records ; i++) { generate(s, 2); }
+
+    SemanticAction sa;
+    Lexer<Value, SemanticAction> lexer(sa, s.data(), s.data() + s.size());
+    std::vector<Lexeme> tokens;
+    for (;;) {
+        Value v;
+        Lexeme x;
+        x.token = lexer.next(v);
+        x.n = v.n;
+        tokens.push_back(x);
+        if (x.token == token_eof) { break; }
+    }
+    std::cout << records << " records, " << tokens.size() << " tokens, "
+              << std::thread::hardware_concurrency() << " cores"
+              << std::endl;
+
+    Result expected = run(tokens, rounds, sequential);
+    std::cout << "sequential: " << expected.ms << " ms" << std::endl;
+    if (!expected.accepted || int(expected.entries.size()) != records) {
+        std::cerr << "sequential parse failed" << std::endl;
+        return 1;
+    }
+
+    int failed = 0;
+    for (unsigned int threads = 1 ; threads <= 16 ; threads *= 2) {
+        failed |= compare("parallel", expected, tokens, rounds, threads);
+    }
+
+    // a syntax error stops both at the same token
+    std::vector<Lexeme> broken(tokens);
+    for (size_t i = broken.size() / 3 ; i < broken.size() ; i++) {
+        if (broken[i].token == token_Colon) {
+            broken[i].token = token_Comma;
+            break;
+        }
+    }
+    Result rejected = run(broken, 1, sequential);
+    failed |= compare("syntax error,", rejected, broken, 1, 4);
+
+    return failed;
+}
@@ -0,0 +1,122 @@
+// benchmark for the %lex SIMD kernels: scans generated records with the
+// Lexer of records.ipp; build it with -DCAPER_LEX_SIMD=0 too and compare
+// the rates (the token counts and checksums must agree)
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include "records.ipp"
+
+using namespace records;
+
+struct SemanticAction {
+    void lexeme(Token, const char* b, const char* e, int& v) {
+        v = int(e - b);
+    }
+};
+
+unsigned pick(unsigned n) {
+    static unsigned long long seed = 88172645463325252ULL;
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+    return unsigned(seed % n);
+}
+
+void word(std::string& s, unsigned length) {
+    static const char letters[] =
+        "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ_0123456789";
+    s += letters[pick(53)];
+    for (unsigned i = 1 ; i < length ; i++) { s += letters[pick(63)]; }
+}
+
+void generate(std::string& s, int depth, int indent) {
+    for (unsigned i = pick(12) + 1 ; 0 < i ; i--) {
+        s.append(indent, ' ');
+        switch (pick(8)) {
+            case 0:
+                s += "// ";
+                for (unsigned k = pick(8) + 2 ; 0 < k ; k--) {
+                    word(s, pick(8) + 1);
+                    s += ' ';
+                }
+                s += "\n";
+                continue;
+            case 1:
+                s += "/* ";
+                for (unsigned k = pick(12) + 2 ; 0 < k ; k--) {
+                    word(s, pick(8) + 1);
+                    s += pick(4) == 0 ? "\n" : " * ";
+                }
+                s += "*/\n";
+                continue;
+        }
+        word(s, pick(16) + 4);
+        if (0 < depth && pick(8) == 0) {
+            s += " {\n";
+            generate(s, depth - 1, indent + 4);
+            s.append(indent, ' ');
+            s += "}\n";
+            continue;
+        }
+        s += " = ";
+        switch (pick(3)) {
+            case 0:
+                s += '"';
+                for (unsigned k = pick(10) + 1 ; 0 < k ; k--) {
+                    word(s, pick(10) + 1);
+                    s += pick(8) == 0 ? "\\\" " : " ";
+                }
+                s += '"';
+                break;
+            case 1:
+                s += std::to_string(pick(1000000));
+                break;
+            default:
+                word(s, pick(12) + 1);
+                break;
+        }
+        s += ";\n";
+    }
+}
+
+int main(int argc, char** argv) {
+    size_t size = 1 << 26;
+    if (1 < argc) { size = size_t(atol(argv[1])); }
+
+    std::string s;
+    while (s.size() < size) {
+        generate(s, 3, 0);
+    }
+
+    SemanticAction sa;
+    size_t n = 0;
+    unsigned long long x = 0;
+
+    typedef std::chrono::steady_clock clock_type;
+    clock_type::time_point t0 = clock_type::now();
+    Lexer<int, SemanticAction> lexer(sa, s.data(), s.data() + s.size());
+    for (;;) {
+        int v;
+        Token t = lexer.next(v);
+        if (t == token_eof) { break; }
+        x = x * 31 + unsigned(t) * 100003 + unsigned(v);
+        n++;
+    }
+    clock_type::time_point t1 = clock_type::now();
+
+    if (lexer.error()) {
+        std::cerr << "error at " << lexer.position() - s.data() << std::endl;
+        return 1;
+    }
+
+    double seconds = double(
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            t1 - t0).count()) / 1000000;
+    std::cout << s.size() << " bytes, " << n << " tokens (" << x << "), "
+              << "CAPER_LEX_SIMD=" << CAPER_LEX_SIMD << ": "
+              << double(s.size()) / (1 << 20) / seconds << " MB/s"
+              << std::endl;
+    return 0;
+}
@@ -0,0 +1,137 @@
+// benchmark for %recover_sync: key=value lines, some of them followed by a
+// long run of garbage before their newline, parsed with loglines.ipp and
+// with loglines_sync.ipp, the same grammar with %recover_sync. Without it
+// every garbage token is recovered from, popping and shifting the error
+// token again; with it the tokens are skipped. The lines taken and skipped
+// must agree, only the syntax errors reported differ
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include "loglines.ipp"
+#include "loglines_sync.ipp"
+
+struct SemanticAction {
+    int errors = 0;
+    int records = 0;
+    int skipped = 0;
+
+    void syntax_error() { errors++; }
+    void stack_overflow() {}
+    void downcast(int& x, int y) { x = y; }
+    void upcast(int& x, int y) { x = y; }
+
+    int First(int x) { return x; }
+    int Next(int x, int y) { return int((x * 31u + y) & 0x7fffffff); }
+    int Record(int key, int value) { records++; return key ^ value; }
+    int Skip() { skipped++; return 0; }
+};
+
+// both parsers number the tokens alike
+struct Lexeme {
+    loglines::Token token;
+    int             n;
+};
+
+unsigned pick(unsigned n) {
+    static unsigned long long seed = 88172645463325252ULL;
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+    return unsigned(seed % n);
+}
+
+void push(std::vector<Lexeme>& tokens, loglines::Token t, int n = 0) {
+    Lexeme x;
+    x.token = t;
+    x.n = n;
+    tokens.push_back(x);
+}
+
+struct Result {
+    bool    accepted;
+    int     value;
+    int     records;
+    int     skipped;
+    int     errors;
+    double  ms;
+};
+
+template <class Token, class Parser>
+Result run(const std::vector<Lexeme>& tokens, int rounds) {
+    typedef std::chrono::steady_clock clock;
+    Result r;
+    clock::time_point t0 = clock::now();
+    for (int k = 0 ; k < rounds ; k++) {
+        SemanticAction sa;
+        Parser parser(sa);
+        parser.post_range(
+            tokens.begin(), tokens.end(),
+            [](const Lexeme& x) { return Token(x.token); },
+            [](const Lexeme& x) { return x.n; });
+        r.accepted = !parser.error() && parser.accept(r.value);
+        r.records = sa.records;
+        r.skipped = sa.skipped;
+        r.errors = sa.errors;
+    }
+    clock::time_point t1 = clock::now();
+    r.ms = std::chrono::duration_cast<std::chrono::microseconds>(
+        t1 - t0).count() / 1000.0 / rounds;
+    return r;
+}
+
+void report(const char* label, const Result& r) {
+    std::cout << label << ": " << r.ms << " ms, " << r.records
+              << " records, " << r.skipped << " skipped, " << r.errors
+              << " syntax errors" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    int lines = 100000;
+    int garbage = 64;
+    int rounds = 5;
+    if (1 < argc) { lines = atoi(argv[1]); }
+    if (2 < argc) { garbage = atoi(argv[2]); }
+    if (3 < argc) { rounds = atoi(argv[3]); }
+
+    // one line in eight breaks off after a few tokens into garbage
+    std::vector<Lexeme> tokens;
+    for (int i = 0 ; i < lines ; i++) {
+        int n = 3;
+        if (pick(8) == 0) { n = int(pick(3)); }
+        if (0 < n) { push(tokens, loglines::token_Word, int(pick(1000))); }
+        if (1 < n) { push(tokens, loglines::token_Equal); }
+        if (2 < n) { push(tokens, loglines::token_Number, int(pick(1000))); }
+        if (n < 3) {
+            for (int j = 1 + int(pick(garbage * 2)) ; 0 < j ; j--) {
+                static const loglines::Token junk[] = {
+                    loglines::token_Word, loglines::token_Equal,
+                    loglines::token_Number
+                };
+                push(tokens, junk[pick(3)], int(pick(1000)));
+            }
+        }
+        push(tokens, loglines::token_NewLine);
+    }
+    push(tokens, loglines::token_eof);
+    std::cout << lines << " lines, " << tokens.size() << " tokens"
+              << std::endl;
+
+    Result plain = run<loglines::Token,
+                       loglines::Parser<int, SemanticAction>>(tokens, rounds);
+    Result sync = run<loglines_sync::Token,
+                      loglines_sync::Parser<int, SemanticAction>>(
+                          tokens, rounds);
+    report("%recover     ", plain);
+    report("%recover_sync", sync);
+    std::cout << plain.ms / sync.ms << "x" << std::endl;
+
+    if (!plain.accepted || plain.accepted != sync.accepted ||
+        plain.value != sync.value || plain.records != sync.records ||
+        plain.skipped != sync.skipped || plain.errors < sync.errors) {
+        std::cerr << "results differ" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,147 @@
+// benchmark for parser reuse: parses many tiny expressions, each with its
+// own semantic action as a server would per request, with lexcalc.ipp.
+// a parser made for every request is compared with one rebound by
+// reset(sa) and with a ParserPool; operator new is counted to show the
+// allocations each way leaves per parse
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+#include "lexcalc.ipp"
+
+using namespace lexcalc;
+
+static unsigned long long allocations = 0;
+
+void* operator new(size_t size) {
+    allocations++;
+    if (void* p = std::malloc(size ? size : 1)) { return p; }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+// the state of one request
+struct SemanticAction {
+    int numbers = 0;
+
+    void syntax_error() {}
+    void stack_overflow() {}
+    void downcast(int& x, int y) { x = y; }
+    void upcast(int& x, int y) { x = y; }
+
+    void lexeme(Token t, const char* b, const char* e, int& v) {
+        v = 0;
+        if (t == token_Number) {
+            numbers++;
+            for (; b != e ; ++b) { v = v * 10 + (*b - '0'); }
+        }
+    }
+
+    int Identity(int n) { return n; }
+    int MakeAdd(int x, int y) { return x + y; }
+    int MakeSub(int x, int y) { return x - y; }
+    int MakeMul(int x, int y) { return x * y; }
+    int MakeDiv(int x, int y) { return y ? x / y : 0; }
+};
+
+typedef Parser<int, SemanticAction> parser_type;
+typedef Lexer<int, SemanticAction> lexer_type;
+
+int parse(parser_type& parser, SemanticAction& sa, const std::string& s) {
+    lexer_type lexer(sa, s.data(), s.data() + s.size());
+    int v;
+    if (!parser.parse(lexer, v)) { return -1; }
+    return v + sa.numbers;
+}
+
+struct Result {
+    double              ns;
+    double              allocations;
+    unsigned long long  checksum;
+};
+
+template <class F>
+Result run(const std::vector<std::string>& inputs, int rounds, F f) {
+    typedef std::chrono::steady_clock clock;
+    unsigned long long checksum = 0;
+    for (const auto& s: inputs) { checksum += f(s); } // warm up
+
+    checksum = 0;
+    unsigned long long a = allocations;
+    clock::time_point t0 = clock::now();
+    for (int k = 0 ; k < rounds ; k++) {
+        for (const auto& s: inputs) { checksum += f(s); }
+    }
+    clock::time_point t1 = clock::now();
+
+    double n = double(inputs.size()) * rounds;
+    Result r;
+    r.ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        t1 - t0).count() / n;
+    r.allocations = (allocations - a) / n;
+    r.checksum = checksum;
+    return r;
+}
+
+void report(const char* label, const Result& r) {
+    std::cout << label << ": " << r.ns << " ns/parse, "
+              << r.allocations << " allocations/parse ("
+              << r.checksum << ")" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    int rounds = 20000;
+    if (1 < argc) { rounds = atoi(argv[1]); }
+
+    std::vector<std::string> inputs;
+    inputs.push_back("1");
+    inputs.push_back("1+2");
+    inputs.push_back("2*3-4");
+    inputs.push_back("(1+2)*3");
+    inputs.push_back("10/(5-3)");
+    inputs.push_back("7*(8+9)/2");
+    inputs.push_back("1+2+3+4");
+    inputs.push_back("((42))");
+
+    Result fresh = run(inputs, rounds, [](const std::string& s) {
+            SemanticAction sa;
+            parser_type parser(sa);
+            return parse(parser, sa, s);
+        });
+
+    SemanticAction first;
+    parser_type reused(first);
+    reused.reserve(64);
+    Result reset = run(inputs, rounds, [&](const std::string& s) {
+            SemanticAction sa;
+            reused.reset(sa);
+            return parse(reused, sa, s);
+        });
+
+    ParserPool<parser_type> pool;
+    pool.reserve(1, 64, first);
+    Result pooled = run(inputs, rounds, [&](const std::string& s) {
+            SemanticAction sa;
+            parser_type* parser = pool.acquire(sa);
+            int v = parse(*parser, sa, s);
+            pool.release(parser);
+            return v;
+        });
+
+    report("new parser", fresh);
+    report("reset(sa) ", reset);
+    report("ParserPool", pooled);
+
+    if (fresh.checksum != reset.checksum ||
+        fresh.checksum != pooled.checksum) {
+        std::cerr << "results differ" << std::endl;
+        return 1;
+    }
+    return 0;
+}